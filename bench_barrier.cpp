@@ -0,0 +1,130 @@
+/**
+* Benchmark for the synchronization backends usable with mylib.
+*
+* Measures the average time per mylib_ThreadControl_sync() for the built-in barriers of mylib
+* and for the user-provided callbacks of the examples (pthread_barrier_t and the C++11 Barrier class)
+* at team sizes from 2 to 64 threads.
+*
+* Usage: ./bench_barrier [iterations]
+*
+* License: MIT/X11 license (see file LICENSE.txt)
+*/
+
+#include <pthread.h>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+
+#include "mylib.h"
+#include "cpp11_barrier.hpp"
+
+
+/* Callback routine for pthread synchronization, as in with_pthread.c */
+void pthread_sync(int tid, int tsize, void *data)
+{
+  pthread_barrier_wait(reinterpret_cast<pthread_barrier_t*>(data));
+}
+
+/* Callback routine for synchronization of C++11 threads, as in with_cpp11threads.cpp */
+void cpp11thread_sync(int tid, int tsize, void *data)
+{
+  reinterpret_cast<Barrier*>(data)->wait();
+}
+
+
+/* Runs 'iterations' barriers on a team of num_threads threads and returns the average time per barrier in nanoseconds. */
+double time_sync(mylib_ThreadFactory tfactory, int num_threads, int iterations)
+{
+  std::vector<std::thread> threads(num_threads);
+  double elapsed = 0;
+
+  for (int i=0; i<num_threads; ++i)
+  {
+    threads[i] = std::thread([=, &elapsed]
+    {
+      mylib_ThreadControl tcontrol;
+      mylib_ThreadFactory_create_control(tfactory, &tcontrol);
+      tcontrol->tid   = i;
+      tcontrol->tsize = num_threads;
+
+      /* warm up: make sure all threads are running before the clock starts */
+      for (int j=0; j<10; ++j)
+        mylib_ThreadControl_sync(tcontrol);
+
+      auto start = std::chrono::steady_clock::now();
+      for (int j=0; j<iterations; ++j)
+        mylib_ThreadControl_sync(tcontrol);
+      auto stop = std::chrono::steady_clock::now();
+
+      if (i == 0)
+        elapsed = std::chrono::duration<double, std::nano>(stop - start).count();
+
+      mylib_ThreadFactory_destroy_control(tfactory, tcontrol);
+    });
+  }
+
+  for (int i=0; i<num_threads; ++i)
+    threads[i].join();
+
+  return elapsed / iterations;
+}
+
+
+int main(int argc, char **argv)
+{
+  int iterations = (argc > 1) ? std::atoi(argv[1]) : 1000;
+
+  std::printf("# Average time per mylib_ThreadControl_sync() in nanoseconds, %d iterations\n", iterations);
+  std::printf("%8s %12s %12s %10s %14s %12s %16s %14s\n", "threads", "mylib_spin", "mylib_hybrid", "(parked)", "dissemination", "tournament", "pthread_barrier", "cpp11_Barrier");
+
+  for (int num_threads = 2; num_threads <= 64; num_threads *= 2)
+  {
+    mylib_ThreadFactory tfactory;
+
+    /* built-in sense-reversing barrier */
+    mylib_ThreadFactory_create_spin(&tfactory, num_threads);
+    double t_spin = time_sync(tfactory, num_threads, iterations);
+    mylib_ThreadFactory_destroy(tfactory);
+
+    /* built-in hybrid barrier with default spin budget. Reports the fraction of waits which had to park. */
+    long spin_waits, parked_waits;
+    mylib_ThreadFactory_create_hybrid(&tfactory, num_threads);
+    double t_hybrid = time_sync(tfactory, num_threads, iterations);
+    mylib_ThreadFactory_get_sync_stats(tfactory, &spin_waits, &parked_waits);
+    mylib_ThreadFactory_destroy(tfactory);
+
+    /* built-in log(P) barriers */
+    mylib_ThreadFactory_create_dissemination(&tfactory, num_threads);
+    double t_dissemination = time_sync(tfactory, num_threads, iterations);
+    mylib_ThreadFactory_destroy(tfactory);
+
+    mylib_ThreadFactory_create_tournament(&tfactory, num_threads);
+    double t_tournament = time_sync(tfactory, num_threads, iterations);
+    mylib_ThreadFactory_destroy(tfactory);
+
+    /* pthread_barrier_t callback */
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, num_threads);
+    mylib_ThreadFactory_create(&tfactory);
+    tfactory->sync      = pthread_sync;
+    tfactory->sync_data = &barrier;
+    double t_pthread = time_sync(tfactory, num_threads, iterations);
+    mylib_ThreadFactory_destroy(tfactory);
+    pthread_barrier_destroy(&barrier);
+
+    /* C++11 Barrier callback */
+    Barrier cpp11_barrier(num_threads);
+    mylib_ThreadFactory_create(&tfactory);
+    tfactory->sync      = cpp11thread_sync;
+    tfactory->sync_data = &cpp11_barrier;
+    double t_cpp11 = time_sync(tfactory, num_threads, iterations);
+    mylib_ThreadFactory_destroy(tfactory);
+
+    std::printf("%8d %12.0f %12.0f %9.1f%% %14.0f %12.0f %16.0f %14.0f\n", num_threads, t_spin, t_hybrid, 100.0 * parked_waits / (spin_waits + parked_waits),
+                t_dissemination, t_tournament, t_pthread, t_cpp11);
+  }
+
+  return EXIT_SUCCESS;
+}
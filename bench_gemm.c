@@ -0,0 +1,263 @@
+/**
+* GFLOP/s benchmark for the dense matrix-matrix product of mylib.
+*
+* Measures C = A * B for square row-major matrices with mylib_matrix_gemm() and with a naive triple loop (i-k-j order, rows of C split across threads).
+* Sizes double from 128 to the given maximum. The naive loop is skipped above 1024, where it would dominate the run time.
+* Reports the best rate over a number of repetitions, counting 2 * n^3 floating point operations. The gemm^T column times C = A^T * B^T.
+* Every product is compared with a serial reference on a sample of rows. Before timing, all combinations of transposes are checked
+* for sizes that are not multiples of the register tiles of the kernels.
+*
+* Usage: ./bench_gemm [maximum size] [threads]
+*
+* License: MIT/X11 license (see file LICENSE.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#include "mylib.h"
+
+#define VARIANT_NAIVE  0
+#define VARIANT_MYLIB  1
+
+/* Largest size for which the naive loop is timed */
+#define NAIVE_MAX_SIZE  1024
+
+/* Number of rows of C compared with the reference, at least */
+#define CHECK_ROWS  128
+
+/* Sizes checked before timing: not multiples of the 4x4, 6x8 and 8x16 tiles, and larger than one MC x KC block for the last */
+static const int check_sizes[] = {1, 5, 37, 301};
+
+/* Data holder passed to mylib_run() */
+typedef struct
+{
+  double *A;
+  double *B;
+  double *C;
+  int n;
+  int transa;
+  int transb;
+  int variant;
+  int repetitions;
+  double best;         /* best time of a matrix-matrix product in seconds */
+} ArgumentT;
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* mylib_run() entry point for creating the matrices */
+void bench_init(mylib_ThreadControl tcontrol, void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  double *A, *B, *C;
+  int i, begin_index, end_index;
+
+  mylib_vector_alloc(tcontrol, args->n * args->n, MYLIB_MEMORY_FIRST_TOUCH, &A);
+  mylib_vector_alloc(tcontrol, args->n * args->n, MYLIB_MEMORY_FIRST_TOUCH, &B);
+  mylib_vector_alloc(tcontrol, args->n * args->n, MYLIB_MEMORY_FIRST_TOUCH, &C);
+
+  /* Small integers without structure aligned to the tiles, so that the products are exact and misplaced entries show up */
+  mylib_vector_partition(tcontrol, args->n * args->n, &begin_index, &end_index);
+  for (i = begin_index; i < end_index; ++i)
+  {
+    A[i] = i % 7 - 3;
+    B[i] = i % 5 - 2;
+  }
+
+  if (tcontrol->tid == 0)
+  {
+    args->A = A;
+    args->B = B;
+    args->C = C;
+  }
+}
+
+/* Naive C = A * B for the rows of the calling thread */
+static void naive_gemm(mylib_ThreadControl tcontrol, ArgumentT *args)
+{
+  int i, j, p, begin_index, end_index, n = args->n;
+
+  mylib_vector_partition(tcontrol, n, &begin_index, &end_index);
+
+  for (i = begin_index; i < end_index; ++i)
+  {
+    double *c = args->C + (size_t)i * n;
+
+    for (j = 0; j < n; ++j)
+      c[j] = 0;
+    for (p = 0; p < n; ++p)
+    {
+      double a = args->A[(size_t)i * n + p];
+      const double *b = args->B + (size_t)p * n;
+
+      for (j = 0; j < n; ++j)
+        c[j] += a * b[j];
+    }
+  }
+}
+
+/* mylib_run() entry point for the timed matrix-matrix products */
+void bench_gemm(mylib_ThreadControl tcontrol, void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  double start = 0, elapsed;
+  int r;
+
+  if (tcontrol->tid == 0)
+    args->best = 1e30;
+
+  for (r = 0; r < args->repetitions; ++r)
+  {
+    mylib_ThreadControl_sync(tcontrol);
+    if (tcontrol->tid == 0)
+      start = now();
+
+    if (args->variant == VARIANT_MYLIB)
+      mylib_matrix_gemm(tcontrol, args->transa, args->transb, args->n, args->n, args->n,
+                        1.0, args->A, args->n, args->B, args->n, 0.0, args->C, args->n);
+    else
+      naive_gemm(tcontrol, args);
+    mylib_ThreadControl_sync(tcontrol);
+
+    if (tcontrol->tid == 0)
+    {
+      elapsed = now() - start;
+      if (elapsed < args->best)
+        args->best = elapsed;
+    }
+  }
+}
+
+/* Compares row i of C with row i of op(A) * op(B) computed by a serial loop, using row as scratch of n entries. Returns 0 if they agree. */
+static int check_row(ArgumentT *args, int i, double *row)
+{
+  int j, p, n = args->n;
+
+  for (j = 0; j < n; ++j)
+    row[j] = 0;
+  for (p = 0; p < n; ++p)
+  {
+    double a = args->transa ? args->A[(size_t)p * n + i] : args->A[(size_t)i * n + p];
+
+    for (j = 0; j < n; ++j)
+      row[j] += a * (args->transb ? args->B[(size_t)j * n + p] : args->B[(size_t)p * n + j]);
+  }
+
+  for (j = 0; j < n; ++j)
+    if (fabs(args->C[(size_t)i * n + j] - row[j]) > 1e-9 * (1 + fabs(row[j])))
+      return -1;
+  return 0;
+}
+
+/* Compares every row of C up to CHECK_ROWS rows, otherwise a strided sample of rows and the last row. Returns 0 if they agree with the reference. */
+static int check_product(ArgumentT *args)
+{
+  int i, n = args->n, stride = (n > CHECK_ROWS) ? n / CHECK_ROWS : 1;
+  double *row = (double *)malloc(n * sizeof(double));
+  int errors;
+
+  if (!row)
+    return -1;
+
+  errors = check_row(args, n - 1, row);
+  for (i = 0; i < n && !errors; i += stride)
+    errors = check_row(args, i, row);
+
+  free(row);
+  return errors;
+}
+
+/* Runs one variant and returns the rate in GFLOP/s, or a negative value on wrong results */
+static double bench_run(mylib_ThreadFactory tfactory, ArgumentT *args, int variant, int transa, int transb)
+{
+  args->variant = variant;
+  args->transa  = transa;
+  args->transb  = transb;
+  mylib_run(tfactory, bench_gemm, args);
+
+  if (check_product(args))
+    return -1;
+
+  return 2.0 * args->n * args->n * args->n / args->best * 1e-9;
+}
+
+
+int main(int argc, char **argv)
+{
+  int max_size    = (argc > 1) ? atoi(argv[1]) : 2048;
+  int num_threads = 0;
+  int n, i;
+  mylib_ThreadFactory tfactory;
+
+  if (argc > 2)
+    num_threads = atoi(argv[2]);
+  else
+    mylib_get_topology(&num_threads, NULL, NULL);
+
+  if (mylib_ThreadFactory_create_pool(&tfactory, num_threads))
+  {
+    printf("Error: Failed to create pool of %d threads\n", num_threads);
+    return EXIT_FAILURE;
+  }
+
+  /* Sizes that leave partial tiles for all kernels, in every combination of transposes */
+  for (i = 0; i < (int)(sizeof(check_sizes) / sizeof(check_sizes[0])); ++i)
+  {
+    ArgumentT args;
+    int trans;
+
+    args.n = check_sizes[i];
+    args.repetitions = 1;
+    mylib_run(tfactory, bench_init, &args);
+
+    for (trans = 0; trans < 4; ++trans)
+      if (bench_run(tfactory, &args, VARIANT_MYLIB, (trans & 1) ? MYLIB_MATRIX_TRANS : MYLIB_MATRIX_NOTRANS,
+                    (trans & 2) ? MYLIB_MATRIX_TRANS : MYLIB_MATRIX_NOTRANS) < 0)
+        printf("Error: Wrong matrix-matrix product for n = %d, transa = %d, transb = %d\n", args.n, trans & 1, trans >> 1);
+
+    mylib_vector_free(args.A);
+    mylib_vector_free(args.B);
+    mylib_vector_free(args.C);
+  }
+
+  printf("# Best rate of C = A * B in GFLOP/s for n-by-n matrices, %d threads\n", num_threads);
+  printf("%8s %12s %12s %12s %10s\n", "n", "naive", "gemm", "gemm^T", "speedup");
+
+  for (n = 128; n <= max_size; n *= 2)
+  {
+    ArgumentT args;
+    double naive = 0, gemm, gemm_trans;
+
+    args.n = n;
+    /* About 2^31 floating point operations per variant, but at least two repetitions */
+    args.repetitions = 2 + (1 << 30) / ((double)n * n * n);
+    mylib_run(tfactory, bench_init, &args);
+
+    gemm = bench_run(tfactory, &args, VARIANT_MYLIB, MYLIB_MATRIX_NOTRANS, MYLIB_MATRIX_NOTRANS);
+    gemm_trans = bench_run(tfactory, &args, VARIANT_MYLIB, MYLIB_MATRIX_TRANS, MYLIB_MATRIX_TRANS);
+    if (n <= NAIVE_MAX_SIZE)
+      naive = bench_run(tfactory, &args, VARIANT_NAIVE, MYLIB_MATRIX_NOTRANS, MYLIB_MATRIX_NOTRANS);
+
+    if (gemm < 0 || gemm_trans < 0 || naive < 0)
+      printf("Error: Wrong matrix-matrix product for n = %d\n", n);
+
+    if (n <= NAIVE_MAX_SIZE)
+      printf("%8d %12.2f %12.2f %12.2f %9.2fx\n", n, naive, gemm, gemm_trans, gemm / naive);
+    else
+      printf("%8d %12s %12.2f %12.2f %10s\n", n, "-", gemm, gemm_trans, "-");
+
+    mylib_vector_free(args.A);
+    mylib_vector_free(args.B);
+    mylib_vector_free(args.C);
+  }
+
+  mylib_ThreadFactory_destroy(tfactory);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+/**
+* Benchmark for the dense matrix-vector product of mylib.
+*
+* Compares mylib_matrix_gemv() to a naive loop on the same rows per thread, for y = A * x and y = A^T * x with square row-major matrices.
+* Sizes double from 256 (matrix resident in the L2 cache) to the given maximum (matrix far beyond the last-level cache, i.e. bound by memory bandwidth).
+* Reports the best bandwidth over a number of repetitions in GB/s, counting the 8 * n * n bytes of the matrix.
+* The naive transposed loop computes each entry of y with a column-wise walk over A, as a direct translation of the formula would.
+*
+* Usage: ./bench_gemv [maximum size] [threads]
+*
+* License: MIT/X11 license (see file LICENSE.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#include "mylib.h"
+
+#define VARIANT_NAIVE  0
+#define VARIANT_MYLIB  1
+
+/* Data holder passed to mylib_run() */
+typedef struct
+{
+  double *A;
+  double *x;
+  double *y;
+  int n;
+  int trans;
+  int variant;
+  int repetitions;
+  double best;         /* best time of a matrix-vector product in seconds */
+} ArgumentT;
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* mylib_run() entry point for creating matrix and vectors */
+void bench_init(mylib_ThreadControl tcontrol, void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  double *A, *x, *y;
+  int i, begin_index, end_index;
+
+  /* The partition of the n * n entries of A is close to the partition of its rows, so pages are placed near the threads using them */
+  mylib_vector_alloc(tcontrol, args->n * args->n, MYLIB_MEMORY_FIRST_TOUCH, &A);
+  mylib_vector_alloc(tcontrol, args->n, MYLIB_MEMORY_FIRST_TOUCH, &x);
+  mylib_vector_alloc(tcontrol, args->n, MYLIB_MEMORY_FIRST_TOUCH, &y);
+
+  mylib_vector_partition(tcontrol, args->n * args->n, &begin_index, &end_index);
+  for (i = begin_index; i < end_index; ++i)
+    A[i] = (i % args->n == i / args->n) ? 2.0 : 1.0 / args->n;
+
+  mylib_vector_partition(tcontrol, args->n, &begin_index, &end_index);
+  for (i = begin_index; i < end_index; ++i)
+    x[i] = 1.0;
+
+  if (tcontrol->tid == 0)
+  {
+    args->A = A;
+    args->x = x;
+    args->y = y;
+  }
+}
+
+/* Naive y = A * x or y = A^T * x for the rows (columns) of the calling thread */
+static void naive_gemv(mylib_ThreadControl tcontrol, ArgumentT *args)
+{
+  int i, j, begin_index, end_index, n = args->n;
+
+  mylib_vector_partition(tcontrol, n, &begin_index, &end_index);
+
+  for (i = begin_index; i < end_index; ++i)
+  {
+    double sum = 0;
+
+    if (args->trans == MYLIB_MATRIX_NOTRANS)
+      for (j = 0; j < n; ++j)
+        sum += args->A[(size_t)i * n + j] * args->x[j];
+    else
+      for (j = 0; j < n; ++j)
+        sum += args->A[(size_t)j * n + i] * args->x[j];
+
+    args->y[i] = sum;
+  }
+}
+
+/* mylib_run() entry point for the timed matrix-vector products */
+void bench_gemv(mylib_ThreadControl tcontrol, void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  double start = 0, elapsed;
+  int r;
+
+  if (tcontrol->tid == 0)
+    args->best = 1e30;
+
+  for (r = 0; r < args->repetitions; ++r)
+  {
+    mylib_ThreadControl_sync(tcontrol);
+    if (tcontrol->tid == 0)
+      start = now();
+
+    if (args->variant == VARIANT_MYLIB)
+      mylib_matrix_gemv(tcontrol, args->trans, args->n, args->n, 1.0, args->A, args->n, args->x, 0.0, args->y);
+    else
+      naive_gemv(tcontrol, args);
+    mylib_ThreadControl_sync(tcontrol);
+
+    if (tcontrol->tid == 0)
+    {
+      elapsed = now() - start;
+      if (elapsed < args->best)
+        args->best = elapsed;
+    }
+  }
+}
+
+/* Runs one variant and returns the bandwidth in GB/s, or a negative value on wrong results */
+static double bench_run(mylib_ThreadFactory tfactory, ArgumentT *args, int trans, int variant)
+{
+  int i;
+
+  args->trans   = trans;
+  args->variant = variant;
+  mylib_run(tfactory, bench_gemv, args);
+
+  /* Each row and each column holds 2 on the diagonal and 1/n elsewhere */
+  for (i = 0; i < args->n; ++i)
+    if (fabs(args->y[i] - (2.0 + (args->n - 1.0) / args->n)) > 1e-12)
+      return -1;
+
+  return 8.0 * args->n * args->n / args->best * 1e-9;
+}
+
+
+int main(int argc, char **argv)
+{
+  int max_size    = (argc > 1) ? atoi(argv[1]) : 8192;
+  int num_threads = 0;
+  int n, trans;
+  mylib_ThreadFactory tfactory;
+
+  if (argc > 2)
+    num_threads = atoi(argv[2]);
+  else
+    mylib_get_topology(&num_threads, NULL, NULL);
+
+  if (mylib_ThreadFactory_create_pool(&tfactory, num_threads))
+  {
+    printf("Error: Failed to create pool of %d threads\n", num_threads);
+    return EXIT_FAILURE;
+  }
+
+  printf("# Best bandwidth of y = op(A) * x in GB/s for n-by-n matrices, %d threads\n", num_threads);
+  printf("%8s %12s %12s %10s %12s %12s %10s\n", "n", "naive", "gemv", "speedup", "naive (T)", "gemv (T)", "speedup");
+
+  for (n = 256; n <= max_size; n *= 2)
+  {
+    ArgumentT args;
+    double bandwidth[2][2];
+
+    args.n = n;
+    /* About 2^28 bytes of matrix traffic per variant, but at least three repetitions */
+    args.repetitions = 3 + (1 << 25) / ((long)n * n);
+    mylib_run(tfactory, bench_init, &args);
+
+    for (trans = MYLIB_MATRIX_NOTRANS; trans <= MYLIB_MATRIX_TRANS; ++trans)
+    {
+      bandwidth[trans][VARIANT_NAIVE] = bench_run(tfactory, &args, trans, VARIANT_NAIVE);
+      bandwidth[trans][VARIANT_MYLIB] = bench_run(tfactory, &args, trans, VARIANT_MYLIB);
+
+      if (bandwidth[trans][VARIANT_NAIVE] < 0 || bandwidth[trans][VARIANT_MYLIB] < 0)
+        printf("Error: Wrong matrix-vector product for n = %d\n", n);
+    }
+
+    printf("%8d %12.2f %12.2f %9.2fx %12.2f %12.2f %9.2fx\n", n,
+           bandwidth[0][VARIANT_NAIVE], bandwidth[0][VARIANT_MYLIB], bandwidth[0][VARIANT_MYLIB] / bandwidth[0][VARIANT_NAIVE],
+           bandwidth[1][VARIANT_NAIVE], bandwidth[1][VARIANT_MYLIB], bandwidth[1][VARIANT_MYLIB] / bandwidth[1][VARIANT_NAIVE]);
+
+    mylib_vector_free(args.A);
+    mylib_vector_free(args.x);
+    mylib_vector_free(args.y);
+  }
+
+  mylib_ThreadFactory_destroy(tfactory);
+  return EXIT_SUCCESS;
+}
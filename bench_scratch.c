@@ -0,0 +1,168 @@
+/**
+* Benchmark for the per-thread reduction scratch of mylib.
+*
+* Measures the time of a dot product for three ways of collecting the partial results of the threads:
+*  - packed:   threads accumulate directly into a packed array thread_results[tid], i.e. up to eight threads write to the same cache line in every iteration.
+*  - padded:   threads accumulate directly into their slot of mylib_ThreadControl_scratch(), i.e. each thread writes to its own cache line.
+*  - register: threads accumulate in a local variable and write the result to their slot of mylib_ThreadControl_scratch() once.
+* Team sizes range from 1 to 64 threads, provided by a pool-backed ThreadFactory.
+*
+* Usage: ./bench_scratch [vector size] [repetitions]
+*
+* License: MIT/X11 license (see file LICENSE.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "mylib.h"
+
+#define LAYOUT_PACKED    0
+#define LAYOUT_PADDED    1
+#define LAYOUT_REGISTER  2
+
+/* Data holder passed to mylib_run() */
+typedef struct
+{
+  double *v1;
+  double *v2;
+  int N;
+  int repetitions;
+  int layout;
+  double *packed;      /* thread_results array of the packed layout, 64 entries */
+  double result;       /* result of the last dot product */
+  double elapsed;      /* average time per dot product in seconds */
+} ArgumentT;
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* mylib_run() entry point for creating the vectors */
+void bench_init(mylib_ThreadControl tcontrol, void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  double *v1, *v2;
+  int i, begin_index, end_index;
+
+  mylib_vector_alloc(tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &v1);
+  mylib_vector_alloc(tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &v2);
+
+  mylib_vector_partition(tcontrol, args->N, &begin_index, &end_index);
+  for (i = begin_index; i < end_index; ++i)
+  {
+    v1[i] = 1.0;
+    v2[i] = 2.0;
+  }
+
+  if (tcontrol->tid == 0)
+  {
+    args->v1 = v1;
+    args->v2 = v2;
+  }
+}
+
+/* mylib_run() entry point for the timed dot products */
+void bench_dot(mylib_ThreadControl tcontrol, void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  double *v1 = args->v1, *v2 = args->v2;
+  char *scratch;
+  int stride, r, i, begin_index, end_index;
+  double start = 0;
+
+  mylib_ThreadControl_scratch(tcontrol, sizeof(double), (void **)&scratch, &stride);
+  mylib_vector_partition(tcontrol, args->N, &begin_index, &end_index);
+
+  mylib_ThreadControl_sync(tcontrol);
+  if (tcontrol->tid == 0)
+    start = now();
+
+  for (r = 0; r < args->repetitions; ++r)
+  {
+    /* volatile enforces the memory traffic of accumulating into the array, as an optimizing compiler may otherwise accumulate in a register */
+    volatile double *slot = (args->layout == LAYOUT_PACKED) ? args->packed + tcontrol->tid : (double *)(scratch + tcontrol->tid * stride);
+
+    if (args->layout == LAYOUT_REGISTER)
+    {
+      double partial_result = 0;
+      for (i = begin_index; i < end_index; ++i)
+        partial_result += v1[i] * v2[i];
+      *slot = partial_result;
+    }
+    else
+    {
+      *slot = 0;
+      for (i = begin_index; i < end_index; ++i)
+        *slot += v1[i] * v2[i];
+    }
+
+    mylib_ThreadControl_sync(tcontrol);
+
+    if (tcontrol->tid == 0)
+    {
+      double result = 0;
+      for (i = 0; i < tcontrol->tsize; ++i)
+        result += (args->layout == LAYOUT_PACKED) ? args->packed[i] : *(double *)(scratch + i * stride);
+      args->result = result;
+    }
+
+    mylib_ThreadControl_sync(tcontrol);
+  }
+
+  if (tcontrol->tid == 0)
+    args->elapsed = (now() - start) / args->repetitions;
+}
+
+
+int main(int argc, char **argv)
+{
+  int N           = (argc > 1) ? atoi(argv[1]) : 1000000;
+  int repetitions = (argc > 2) ? atoi(argv[2]) : 20;
+  int num_threads, layout;
+  double packed[64];
+
+  printf("# Average time per dot product of size %d in microseconds, %d repetitions\n", N, repetitions);
+  printf("%8s %12s %12s %12s %10s\n", "threads", "packed", "padded", "register", "speedup");
+
+  for (num_threads = 1; num_threads <= 64; num_threads *= 2)
+  {
+    mylib_ThreadFactory tfactory;
+    ArgumentT args;
+    double elapsed[3];
+
+    if (mylib_ThreadFactory_create_pool(&tfactory, num_threads))
+    {
+      printf("Error: Failed to create pool of %d threads\n", num_threads);
+      return EXIT_FAILURE;
+    }
+
+    args.N           = N;
+    args.repetitions = repetitions;
+    args.packed      = packed;
+    mylib_run(tfactory, bench_init, &args);
+
+    for (layout = LAYOUT_PACKED; layout <= LAYOUT_REGISTER; ++layout)
+    {
+      args.layout = layout;
+      mylib_run(tfactory, bench_dot, &args);
+      elapsed[layout] = args.elapsed;
+
+      if (args.result != 2.0 * N)
+        printf("Error: Wrong dot product %g for %d threads\n", args.result, num_threads);
+    }
+
+    printf("%8d %12.1f %12.1f %12.1f %9.2fx\n", num_threads, 1e6 * elapsed[LAYOUT_PACKED], 1e6 * elapsed[LAYOUT_PADDED], 1e6 * elapsed[LAYOUT_REGISTER],
+           elapsed[LAYOUT_PACKED] / elapsed[LAYOUT_REGISTER]);
+
+    mylib_vector_free(args.v1);
+    mylib_vector_free(args.v2);
+    mylib_ThreadFactory_destroy(tfactory);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+/**
+* Benchmark for the sparse matrix-vector products of mylib.
+*
+* Compares mylib_csr_spmv() to mylib_sell_spmv() for y = A * x on matrices with irregular row lengths:
+*   uniform:   1 to 16 nonzeros per row
+*   power-law: row lengths following a Pareto distribution (mostly a few nonzeros, some rows with thousands)
+* The columns of a row are scattered over a band around the diagonal, so that x is accessed with some locality, as for matrices from discretizations.
+* SELL-C-sigma uses chunks of 8 rows, without sorting (sigma = 1) and with rows sorted within windows of 8192 rows (twice the band, so that sorting keeps the accesses to x local).
+* Reports the best rate over a number of repetitions in GFLOP/s, counting 2 floating point operations per nonzero.
+*
+* Usage: ./bench_spmv [rows] [threads]
+*
+* License: MIT/X11 license (see file LICENSE.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#include "mylib.h"
+
+#define VARIANT_CSR   0
+#define VARIANT_SELL  1
+
+/* Chunk height and sorting window of the SELL-C-sigma matrix */
+#define SELL_C      8
+#define SELL_SIGMA  8192
+
+/* Columns of a row lie within this distance of the diagonal */
+#define BANDWIDTH  4096
+
+/* Longest row of the power-law matrix */
+#define MAX_ROW_LENGTH  4096
+
+/* Data holder passed to mylib_run() */
+typedef struct
+{
+  mylib_CsrPlan plan;
+  mylib_SellMatrix sell;
+  double *x;
+  double *y;
+  int variant;
+  int repetitions;
+  double best;         /* best time of a matrix-vector product in seconds */
+} ArgumentT;
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* Creates the CSR arrays of an m-by-m matrix. power_law selects the distribution of the row lengths. Returns the number of nonzeros, or -1 if out of memory. */
+static long create_matrix(int m, int power_law, int **row_ptr, int **col_idx, double **values)
+{
+  int i, j;
+  long nnz = 0;
+
+  *row_ptr = (int *)malloc((m + 1) * sizeof(int));
+  if (!*row_ptr)
+    return -1;
+
+  srand(42);
+  (*row_ptr)[0] = 0;
+  for (i = 0; i < m; ++i)
+  {
+    int length;
+
+    if (power_law)
+    {
+      double u = (rand() + 1.0) / (RAND_MAX + 1.0);
+
+      length = (int)(1.0 / pow(u, 1.0 / 1.2));
+      if (length > MAX_ROW_LENGTH)
+        length = MAX_ROW_LENGTH;
+    }
+    else
+      length = 1 + rand() % 16;
+
+    if (length > m)
+      length = m;
+    nnz += length;
+    (*row_ptr)[i + 1] = (int)nnz;
+  }
+
+  *col_idx = (int *)malloc(nnz * sizeof(int));
+  *values  = (double *)malloc(nnz * sizeof(double));
+  if (!*col_idx || !*values)
+    return -1;
+
+  for (i = 0; i < m; ++i)
+    for (j = (*row_ptr)[i]; j < (*row_ptr)[i + 1]; ++j)
+    {
+      (*col_idx)[j] = ((i + rand() % (2 * BANDWIDTH) - BANDWIDTH) % m + m) % m;
+      (*values)[j]  = 1.0 / (1 + j - (*row_ptr)[i]);
+    }
+
+  return nnz;
+}
+
+/* mylib_run() entry point for the timed matrix-vector products */
+void bench_spmv(mylib_ThreadControl tcontrol, void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  double start = 0, elapsed;
+  int r;
+
+  if (tcontrol->tid == 0)
+    args->best = 1e30;
+
+  for (r = 0; r < args->repetitions; ++r)
+  {
+    mylib_ThreadControl_sync(tcontrol);
+    if (tcontrol->tid == 0)
+      start = now();
+
+    if (args->variant == VARIANT_SELL)
+      mylib_sell_spmv(tcontrol, args->sell, 1.0, args->x, 0.0, args->y);
+    else
+      mylib_csr_spmv(tcontrol, args->plan, 1.0, args->x, 0.0, args->y);
+    mylib_ThreadControl_sync(tcontrol);
+
+    if (tcontrol->tid == 0)
+    {
+      elapsed = now() - start;
+      if (elapsed < args->best)
+        args->best = elapsed;
+    }
+  }
+}
+
+/* Runs one variant and returns the rate in GFLOP/s, or a negative value if the result differs from the reference */
+static double bench_run(mylib_ThreadFactory tfactory, ArgumentT *args, int variant, const double *reference, int m, long nnz)
+{
+  int i;
+
+  args->variant = variant;
+  mylib_run(tfactory, bench_spmv, args);
+
+  if (reference)
+    for (i = 0; i < m; ++i)
+      if (fabs(args->y[i] - reference[i]) > 1e-12 * (1 + fabs(reference[i])))
+        return -1;
+
+  return 2.0 * nnz / args->best * 1e-9;
+}
+
+
+int main(int argc, char **argv)
+{
+  int m           = (argc > 1) ? atoi(argv[1]) : (1 << 20);
+  int num_threads = 0;
+  int power_law, i;
+  mylib_ThreadFactory tfactory;
+
+  if (argc > 2)
+    num_threads = atoi(argv[2]);
+  else
+    mylib_get_topology(&num_threads, NULL, NULL);
+
+  if (mylib_ThreadFactory_create_pool(&tfactory, num_threads))
+  {
+    printf("Error: Failed to create pool of %d threads\n", num_threads);
+    return EXIT_FAILURE;
+  }
+
+  printf("# Best rate of y = A * x in GFLOP/s for %d-by-%d matrices, %d threads\n", m, m, num_threads);
+  printf("%10s %10s %12s %12s %12s %10s\n", "matrix", "nnz", "csr", "sell sigma=1", "sell sorted", "speedup");
+
+  for (power_law = 0; power_law <= 1; ++power_law)
+  {
+    ArgumentT args;
+    int *row_ptr = NULL, *col_idx = NULL;
+    double *values = NULL, *reference;
+    double rate[3];
+    long nnz = create_matrix(m, power_law, &row_ptr, &col_idx, &values);
+
+    args.x    = (double *)malloc(m * sizeof(double));
+    args.y    = (double *)malloc(m * sizeof(double));
+    reference = (double *)malloc(m * sizeof(double));
+    if (nnz < 0 || !args.x || !args.y || !reference)
+    {
+      printf("Error: Out of memory\n");
+      return EXIT_FAILURE;
+    }
+    for (i = 0; i < m; ++i)
+      args.x[i] = 1.0 + (i % 7);
+
+    /* About 2^30 floating point operations per variant, but at least three repetitions */
+    args.repetitions = 3 + (1 << 29) / nnz;
+
+    mylib_CsrPlan_create(&args.plan, num_threads, m, m, row_ptr, col_idx, values);
+    rate[0] = bench_run(tfactory, &args, VARIANT_CSR, NULL, m, nnz);
+    for (i = 0; i < m; ++i)
+      reference[i] = args.y[i];
+
+    mylib_SellMatrix_create(&args.sell, num_threads, SELL_C, 1, m, m, row_ptr, col_idx, values);
+    rate[1] = bench_run(tfactory, &args, VARIANT_SELL, reference, m, nnz);
+    mylib_SellMatrix_destroy(args.sell);
+
+    mylib_SellMatrix_create(&args.sell, num_threads, SELL_C, SELL_SIGMA, m, m, row_ptr, col_idx, values);
+    rate[2] = bench_run(tfactory, &args, VARIANT_SELL, reference, m, nnz);
+    mylib_SellMatrix_destroy(args.sell);
+
+    if (rate[1] < 0 || rate[2] < 0)
+      printf("Error: Wrong matrix-vector product for the %s matrix\n", power_law ? "power-law" : "uniform");
+
+    printf("%10s %10ld %12.2f %12.2f %12.2f %9.2fx\n", power_law ? "power-law" : "uniform", nnz, rate[0], rate[1], rate[2], rate[2] / rate[0]);
+
+    mylib_CsrPlan_destroy(args.plan);
+    free(row_ptr);
+    free(col_idx);
+    free(values);
+    free(args.x);
+    free(args.y);
+    free(reference);
+  }
+
+  mylib_ThreadFactory_destroy(tfactory);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+/**
+* STREAM-style benchmark for the non-temporal store path of mylib_vector_add().
+*
+* Measures the bandwidth of vresult = v1 + v2 with regular stores (stream_threshold = LONG_MAX) and with
+* non-temporal stores (stream_threshold = 0). As in STREAM, 24 bytes are counted per element (two loads and one store),
+* so the read-for-ownership of vresult that regular stores cause shows up as lower bandwidth.
+* Team sizes range from 1 to 64 threads, provided by a pool-backed ThreadFactory.
+*
+* Usage: ./bench_stream [vector size] [repetitions]
+*
+* License: MIT/X11 license (see file LICENSE.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <time.h>
+
+#include "mylib.h"
+
+/* Data holder passed to mylib_run() */
+typedef struct
+{
+  double *v1;
+  double *v2;
+  double *vresult;
+  int N;
+  int repetitions;
+  double best;         /* best time of a vector addition in seconds */
+} ArgumentT;
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* mylib_run() entry point for creating the vectors */
+void bench_init(mylib_ThreadControl tcontrol, void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  double *v1, *v2, *vresult;
+  int i, begin_index, end_index;
+
+  mylib_vector_alloc(tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &v1);
+  mylib_vector_alloc(tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &v2);
+  mylib_vector_alloc(tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &vresult);
+
+  mylib_vector_partition(tcontrol, args->N, &begin_index, &end_index);
+  for (i = begin_index; i < end_index; ++i)
+  {
+    v1[i] = 1.0;
+    v2[i] = 2.0;
+  }
+
+  if (tcontrol->tid == 0)
+  {
+    args->v1      = v1;
+    args->v2      = v2;
+    args->vresult = vresult;
+  }
+}
+
+/* mylib_run() entry point for the timed vector additions */
+void bench_add(mylib_ThreadControl tcontrol, void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  double start = 0, elapsed;
+  int r;
+
+  if (tcontrol->tid == 0)
+    args->best = 1e30;
+
+  for (r = 0; r < args->repetitions; ++r)
+  {
+    mylib_ThreadControl_sync(tcontrol);
+    if (tcontrol->tid == 0)
+      start = now();
+
+    mylib_vector_add(tcontrol, args->v1, args->v2, args->vresult, args->N);
+    mylib_ThreadControl_sync(tcontrol);
+
+    if (tcontrol->tid == 0)
+    {
+      elapsed = now() - start;
+      if (elapsed < args->best)
+        args->best = elapsed;
+    }
+  }
+}
+
+/* Runs the benchmark with the given streaming threshold and returns the bandwidth in GB/s, or a negative value on wrong results */
+static double bench_run(mylib_ThreadFactory tfactory, ArgumentT *args, long stream_threshold)
+{
+  int i;
+
+  tfactory->stream_threshold = stream_threshold;
+  mylib_run(tfactory, bench_add, args);
+
+  for (i = 0; i < args->N; ++i)
+    if (args->vresult[i] != 3.0)
+      return -1;
+
+  return 24.0 * args->N / args->best * 1e-9;
+}
+
+
+int main(int argc, char **argv)
+{
+  int N           = (argc > 1) ? atoi(argv[1]) : (1 << 24);
+  int repetitions = (argc > 2) ? atoi(argv[2]) : 10;
+  int num_threads;
+
+  printf("# Best bandwidth of vector addition of size %d in GB/s (24 bytes per element), %d repetitions\n", N, repetitions);
+  printf("%8s %12s %12s %12s %10s\n", "threads", "regular", "streaming", "auto", "gain");
+
+  for (num_threads = 1; num_threads <= 64; num_threads *= 2)
+  {
+    mylib_ThreadFactory tfactory;
+    ArgumentT args;
+    double regular, streaming, automatic;
+
+    if (mylib_ThreadFactory_create_pool(&tfactory, num_threads))
+    {
+      printf("Error: Failed to create pool of %d threads\n", num_threads);
+      return EXIT_FAILURE;
+    }
+
+    args.N           = N;
+    args.repetitions = repetitions;
+    mylib_run(tfactory, bench_init, &args);
+
+    regular   = bench_run(tfactory, &args, LONG_MAX);
+    streaming = bench_run(tfactory, &args, 0);
+    automatic = bench_run(tfactory, &args, MYLIB_STREAM_AUTO);
+
+    if (regular < 0 || streaming < 0 || automatic < 0)
+      printf("Error: Wrong vector addition for %d threads\n", num_threads);
+
+    printf("%8d %12.2f %12.2f %12.2f %9.2fx\n", num_threads, regular, streaming, automatic, streaming / regular);
+
+    mylib_vector_free(args.v1);
+    mylib_vector_free(args.v2);
+    mylib_vector_free(args.vresult);
+    mylib_ThreadFactory_destroy(tfactory);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,51 @@
+#ifndef CPP11_BARRIER_HPP
+#define CPP11_BARRIER_HPP
+
+/**
+* C++11 barrier shared by the C++11 thread example and the barrier benchmark.
+*
+* Author: Karl Rupp
+*
+* License: MIT/X11 license (see file LICENSE.txt)
+*/
+
+#include <mutex>
+#include <condition_variable>
+
+/* Implementation of a C++11 barrier. wait() can be called multiple times.
+ * See e.g. http://stackoverflow.com/questions/24465533/implementing-boostbarrier-in-c11 for alternatives.
+ *
+ * This class will most likely be hidden inside 'mylib' if 'mylib' were a mature library and not just for demonstration purposes.
+ */
+class Barrier
+{
+public:
+  explicit Barrier(int num_threads) : threads_required_(num_threads), threads_left_(num_threads), counter_(0) {}
+
+  void wait()
+  {
+    int ctr = counter_;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    threads_left_ -= 1;
+    if (threads_left_ == 0) // all threads arrived
+    {
+     ++counter_;
+     threads_left_ = threads_required_;
+     condition_.notify_all();
+    }
+    else
+    {
+      condition_.wait(lock, [this, ctr] { return ctr != counter_; });
+    }
+  }
+
+private:
+  int threads_required_;
+  int threads_left_;
+  int counter_;
+  std::mutex              mutex_;
+  std::condition_variable condition_;
+};
+
+#endif
@@ -1,8 +1,35 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <sched.h>
 
-#include "mylib.h"
+#include "mylib_internal.h"
+
+
+/************** Internal helpers ****************/
+
+/* Busy-wait step: pause the CPU, and yield the core every 256 iterations so that threads of an oversubscribed team get scheduled. */
+void mylib_spin_pause(unsigned int *iteration)
+{
+  if ((++*iteration & 255) == 0)
+    sched_yield();
+  else
+    mylib_cpu_relax();
+}
+
+/* Allocates size bytes aligned to a cache line. Memory is released with free(). */
+void *mylib_aligned_malloc(size_t size)
+{
+  void *ptr = NULL;
+
+  if (posix_memalign(&ptr, MYLIB_CACHE_LINE, size) != 0)
+    return NULL;
+
+  return ptr;
+}
 
 
 /************** Part 1: Thread Control and Management ****************/
@@ -11,124 +38,911 @@
 /* Creates an empty ThreadFactory object. */
 int mylib_ThreadFactory_create(mylib_ThreadFactory *tfactory)
 {
-  *tfactory = (mylib_ThreadFactory)malloc(sizeof(mylib_ThreadFactory_internal));
+  mylib_ThreadFactory new_tfactory = (mylib_ThreadFactory)malloc(sizeof(mylib_ThreadFactory_internal));
+
+  if (!new_tfactory)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  /* Default team */
+  new_tfactory->teams     = (struct mylib_TeamEntry_s *)calloc(1, sizeof(struct mylib_TeamEntry_s));
+  new_tfactory->num_teams = 1;
+  if (!new_tfactory->teams)
+  {
+    free(new_tfactory);
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+  atomic_flag_clear(&new_tfactory->teams[0].controls_lock);
+
+  /* No synchronization routine registered yet */
+  new_tfactory->sync              = NULL;
+  new_tfactory->sync_data         = NULL;
+  new_tfactory->arrive            = NULL;
+  new_tfactory->wait              = NULL;
+  new_tfactory->sync_data_destroy = NULL;
+  new_tfactory->sync_spin_count   = 4096;
+  new_tfactory->sync_spin_ns      = 50000;
+  new_tfactory->pool              = NULL;
+  new_tfactory->schedule          = MYLIB_SCHEDULE_STATIC;
+  new_tfactory->schedule_grain    = 4096;
+  new_tfactory->stream_threshold  = MYLIB_STREAM_AUTO;
+
+  *tfactory = new_tfactory;
+  return MYLIB_SUCCESS;
+}
+
+/* Creates a ThreadFactory object and registers a built-in barrier of the given kind as synchronization routine. */
+static int mylib_ThreadFactory_create_builtin(mylib_ThreadFactory *tfactory, int kind, int num_threads)
+{
+  int err = mylib_ThreadFactory_create(tfactory);
+
+  if (err)
+    return err;
+
+  err = mylib_barrier_create(kind, num_threads, *tfactory, &(*tfactory)->sync_data);
+  if (!err)
+    err = mylib_team_create(num_threads, &(*tfactory)->teams[0].team);
+  if (err)
+  {
+    mylib_ThreadFactory_destroy(*tfactory);
+    return err;
+  }
+
+  (*tfactory)->sync              = mylib_barrier_sync;
+  (*tfactory)->arrive            = mylib_barrier_arrive;
+  (*tfactory)->wait              = mylib_barrier_wait;
+  (*tfactory)->sync_data_destroy = mylib_barrier_destroy;
+  return MYLIB_SUCCESS;
+}
+
+/* Creates a ThreadFactory object using mylib's built-in sense-reversing spin barrier for a team of num_threads threads. */
+int mylib_ThreadFactory_create_spin(mylib_ThreadFactory *tfactory, int num_threads)
+{
+  return mylib_ThreadFactory_create_builtin(tfactory, MYLIB_BARRIER_SPIN, num_threads);
+}
+
+/* Creates a ThreadFactory object using mylib's built-in hybrid barrier for a team of num_threads threads. */
+int mylib_ThreadFactory_create_hybrid(mylib_ThreadFactory *tfactory, int num_threads)
+{
+  return mylib_ThreadFactory_create_builtin(tfactory, MYLIB_BARRIER_HYBRID, num_threads);
+}
+
+/* Creates a ThreadFactory object using mylib's built-in dissemination barrier for a team of num_threads threads. */
+int mylib_ThreadFactory_create_dissemination(mylib_ThreadFactory *tfactory, int num_threads)
+{
+  return mylib_ThreadFactory_create_builtin(tfactory, MYLIB_BARRIER_DISSEMINATION, num_threads);
+}
+
+/* Creates a ThreadFactory object using mylib's built-in tournament barrier for a team of num_threads threads. */
+int mylib_ThreadFactory_create_tournament(mylib_ThreadFactory *tfactory, int num_threads)
+{
+  return mylib_ThreadFactory_create_builtin(tfactory, MYLIB_BARRIER_TOURNAMENT, num_threads);
+}
+
+/* Creates a ThreadFactory object using the built-in barrier best suited for a team of num_threads threads. */
+int mylib_ThreadFactory_create_auto(mylib_ThreadFactory *tfactory, int num_threads)
+{
+  return mylib_ThreadFactory_create_builtin(tfactory, mylib_barrier_select(num_threads), num_threads);
+}
+
+/* Creates a ThreadFactory object owning a pool of num_threads-1 persistent worker threads. */
+int mylib_ThreadFactory_create_pool(mylib_ThreadFactory *tfactory, int num_threads)
+{
+  int err = mylib_ThreadFactory_create_builtin(tfactory, MYLIB_BARRIER_HYBRID, num_threads);
+
+  if (err)
+    return err;
+
+  err = mylib_pool_create(*tfactory, num_threads);
+  if (err)
+  {
+    mylib_ThreadFactory_destroy(*tfactory);
+    return err;
+  }
+
+  return MYLIB_SUCCESS;
+}
+
+/* Reports how many barrier waits were resolved while busy-waiting and how many had to park. */
+int mylib_ThreadFactory_get_sync_stats(mylib_ThreadFactory tfactory, long *spin_waits, long *parked_waits)
+{
+  if (tfactory->sync != mylib_barrier_sync)
+    return MYLIB_ERROR_NOT_SUPPORTED;
+
+  mylib_barrier_stats(tfactory->sync_data, spin_waits, parked_waits);
+  return MYLIB_SUCCESS;
 }
 
 /* Destroys a ThreadFactory object. */
 int mylib_ThreadFactory_destroy(mylib_ThreadFactory tfactory)
 {
+  int i;
+
+  /* workers use the sync routine until they are joined */
+  mylib_pool_destroy(tfactory, tfactory->pool);
+
+  /* cached thread control objects may still need to complete a synchronization point */
+  for (i = 0; i < tfactory->num_teams; ++i)
+  {
+    int j;
+    for (j = 0; j < tfactory->teams[i].num_controls; ++j)
+      if (tfactory->teams[i].controls[j])
+        mylib_ThreadFactory_destroy_control(tfactory, tfactory->teams[i].controls[j]);
+    free(tfactory->teams[i].controls);
+  }
+
+  if (tfactory->sync_data_destroy)
+    tfactory->sync_data_destroy(tfactory->sync_data);
+
+  for (i = 0; i < tfactory->num_teams; ++i)
+  {
+    if (tfactory->teams[i].sync_data_destroy)
+      tfactory->teams[i].sync_data_destroy(tfactory->teams[i].sync_data);
+    mylib_team_destroy(tfactory->teams[i].team);
+    mylib_arena_destroy(tfactory->teams[i].arena);
+  }
+  free(tfactory->teams);
   free(tfactory);
+  return MYLIB_SUCCESS;
 }
 
 
+/* Adds a team of num_threads threads to the factory and returns its ID in *team. */
+int mylib_ThreadFactory_create_team(mylib_ThreadFactory tfactory, int num_threads, void *sync_data, int *team)
+{
+  struct mylib_TeamEntry_s *teams;
+  struct mylib_TeamEntry_s *entry;
+
+  if (num_threads < 1)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  teams = (struct mylib_TeamEntry_s *)realloc(tfactory->teams, (tfactory->num_teams + 1) * sizeof(struct mylib_TeamEntry_s));
+  if (!teams)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+  tfactory->teams = teams;
+
+  entry = teams + tfactory->num_teams;
+  entry->team              = NULL;
+  entry->arena             = NULL;
+  entry->sync_data         = sync_data;
+  entry->sync_data_destroy = NULL;
+  entry->controls          = NULL;
+  entry->num_controls      = 0;
+  atomic_flag_clear(&entry->controls_lock);
+
+  /* Built-in barriers are sized for a team, hence each team needs its own */
+  if (!sync_data && tfactory->sync == mylib_barrier_sync)
+  {
+    int err = mylib_barrier_create(mylib_barrier_kind(tfactory->sync_data), num_threads, tfactory, &entry->sync_data);
+
+    if (err)
+      return err;
+    entry->sync_data_destroy = mylib_barrier_destroy;
+  }
+
+  *team = tfactory->num_teams++;
+  return MYLIB_SUCCESS;
+}
+
 /* Factory function for creating an empty ThreadControl object. */
 int mylib_ThreadFactory_create_control(mylib_ThreadFactory tfactory, mylib_ThreadControl *tcontrol)
 {
   mylib_ThreadControl new_tcontrol = (mylib_ThreadControl)malloc(sizeof(mylib_ThreadControl_internal));
 
+  if (!new_tcontrol)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
   /* Fill with default parameters */
   new_tcontrol->tid   = 0;
   new_tcontrol->tsize = 0;
+  new_tcontrol->team  = 0;
+  new_tcontrol->core  = -1;
+  new_tcontrol->node  = -1;
+  new_tcontrol->arena_block  = 0;
+  new_tcontrol->arena_offset = 0;
+  new_tcontrol->sync_pending = 0;
+  new_tcontrol->sync_token   = 0;
   new_tcontrol->shared_context = tfactory;
 
   *tcontrol = new_tcontrol;
+  return MYLIB_SUCCESS;
 }
 
-/* Factory function for creating an empty ThreadControl object. */
+/* Returns the cached thread control object of thread tid in the given team, set up for a team of tsize threads. */
+int mylib_ThreadFactory_get_control(mylib_ThreadFactory tfactory, int team, int tid, int tsize, mylib_ThreadControl *tcontrol)
+{
+  struct mylib_TeamEntry_s *entry;
+  mylib_ThreadControl cached;
+  unsigned int spins = 0;
+  int err = MYLIB_SUCCESS;
+
+  if (team < 0 || team >= tfactory->num_teams || tid < 0 || tid >= tsize)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+  entry = tfactory->teams + team;
+
+  /* Only held for a table lookup, or for creating the objects on first use */
+  while (atomic_flag_test_and_set_explicit(&entry->controls_lock, memory_order_acquire))
+    mylib_spin_pause(&spins);
+
+  if (tid >= entry->num_controls)
+  {
+    int i, num_controls = (tsize > 2 * entry->num_controls) ? tsize : 2 * entry->num_controls;
+    mylib_ThreadControl *controls = (mylib_ThreadControl *)realloc(entry->controls, num_controls * sizeof(mylib_ThreadControl));
+
+    if (controls)
+    {
+      for (i = entry->num_controls; i < num_controls; ++i)
+        controls[i] = NULL;
+      entry->controls     = controls;
+      entry->num_controls = num_controls;
+    }
+    else
+      err = MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+
+  if (!err && !entry->controls[tid])
+  {
+    err = mylib_ThreadFactory_create_control(tfactory, entry->controls + tid);
+    if (!err)
+    {
+      entry->controls[tid]->tid  = tid;
+      entry->controls[tid]->team = team;
+    }
+  }
+
+  cached = err ? NULL : entry->controls[tid];
+  atomic_flag_clear_explicit(&entry->controls_lock, memory_order_release);
+
+  if (err)
+    return err;
+
+  if (cached->tsize != tsize)
+    mylib_ThreadControl_rebind(cached, tid, tsize);
+
+  *tcontrol = cached;
+  return MYLIB_SUCCESS;
+}
+
+/* Destroys a ThreadControl object. Completes a pending split-phase synchronization of the thread. */
 int mylib_ThreadFactory_destroy_control(mylib_ThreadFactory tfactory, mylib_ThreadControl tcontrol)
 {
+  if (tcontrol->sync_pending)
+    mylib_ThreadControl_wait(tcontrol, tcontrol->sync_token);
+
   free(tcontrol);
+  return MYLIB_SUCCESS;
 }
 
 
 /* Allocates a shared buffer for all threads in tcontrol. */
 int mylib_ThreadControl_malloc(mylib_ThreadControl tcontrol, int num_bytes, void **ptr)
 {
-  mylib_ThreadControl_sync(tcontrol);
-
-  if (tcontrol->tid == 0)
-    tcontrol->shared_context->shared_data = malloc(num_bytes);
-
-  mylib_ThreadControl_sync(tcontrol);
+  if (num_bytes < 0)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
 
-  *ptr = tcontrol->shared_context->shared_data;
+  return mylib_arena_alloc(tcontrol, num_bytes, ptr);
 }
 
 /* Frees a shared buffer allocated for all threads in tcontrol .*/
 int mylib_ThreadControl_free(mylib_ThreadControl tcontrol, void *ptr)
 {
-  mylib_ThreadControl_sync(tcontrol);
+  int token;
 
-  if (tcontrol->tid == 0)
-    free(ptr);
+  /* No thread waits here: the next allocation completes the arrival before it hands out the memory again */
+  mylib_ThreadControl_arrive(tcontrol, &token);
+
+  return mylib_arena_release(tcontrol, ptr);
+}
+
+/* Assigns a new thread ID and team size to tcontrol. */
+int mylib_ThreadControl_rebind(mylib_ThreadControl tcontrol, int tid, int tsize)
+{
+  if (tid < 0 || tid >= tsize)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  /* A pending synchronization point refers to the old team */
+  if (tcontrol->sync_pending)
+    mylib_ThreadControl_wait(tcontrol, tcontrol->sync_token);
+
+  tcontrol->tid   = tid;
+  tcontrol->tsize = tsize;
+  tcontrol->arena_block  = 0;
+  tcontrol->arena_offset = 0;
+  return MYLIB_SUCCESS;
 }
 
 /* Synchronizes all threads in tcontrol (i.e. no thread proceeds before all threads have reached this point) */
 int mylib_ThreadControl_sync(mylib_ThreadControl tcontrol)
 {
-  tcontrol->shared_context->sync(tcontrol->tid, tcontrol->tsize, tcontrol->shared_context->sync_data);
+  if (tcontrol->sync_pending)
+    mylib_ThreadControl_wait(tcontrol, tcontrol->sync_token);
+
+  tcontrol->shared_context->sync(tcontrol->tid, tcontrol->tsize, mylib_sync_data(tcontrol));
+  return MYLIB_SUCCESS;
+}
+
+/* Split-phase synchronization, first half: Signals that the calling thread has reached a synchronization point. */
+int mylib_ThreadControl_arrive(mylib_ThreadControl tcontrol, int *token)
+{
+  mylib_ThreadFactory tfactory = tcontrol->shared_context;
+
+  if (tcontrol->sync_pending)
+    mylib_ThreadControl_wait(tcontrol, tcontrol->sync_token);
+
+  if (!tfactory->arrive || !tfactory->wait)
+  {
+    /* No split-phase support in the sync routine. A full sync is always correct, the subsequent wait is then a no-op. */
+    tfactory->sync(tcontrol->tid, tcontrol->tsize, mylib_sync_data(tcontrol));
+    *token = 0;
+    return MYLIB_SUCCESS;
+  }
+
+  *token = tfactory->arrive(tcontrol->tid, tcontrol->tsize, mylib_sync_data(tcontrol));
+  tcontrol->sync_pending = 1;
+  tcontrol->sync_token   = *token;
+  return MYLIB_SUCCESS;
+}
+
+/* Split-phase synchronization, second half: Returns once all threads in tcontrol arrived at the synchronization point identified by token. */
+int mylib_ThreadControl_wait(mylib_ThreadControl tcontrol, int token)
+{
+  mylib_ThreadFactory tfactory = tcontrol->shared_context;
+
+  if (!tcontrol->sync_pending)
+    return MYLIB_SUCCESS;
+
+  tcontrol->sync_pending = 0;
+  tfactory->wait(tcontrol->tid, tcontrol->tsize, mylib_sync_data(tcontrol), token);
+  return MYLIB_SUCCESS;
+}
+
+/* Runs fn(tcontrol, arg) on all threads of a pool-backed ThreadFactory and returns once all threads completed. */
+int mylib_run(mylib_ThreadFactory tfactory, void (*fn)(mylib_ThreadControl tcontrol, void *arg), void *arg)
+{
+  if (!tfactory->pool)
+    return MYLIB_ERROR_NOT_SUPPORTED;
+
+  return mylib_pool_run(tfactory->pool, fn, arg);
+}
+
+/* Computes the index range [*begin, *end) of the calling thread when splitting size elements equally over the threads in tcontrol. */
+void mylib_partition(mylib_ThreadControl tcontrol, int size, int *begin, int *end)
+{
+  int elements_per_thread = (size - 1) / tcontrol->tsize + 1;
+
+  /* Whole cache lines per thread: no false sharing at block boundaries, and blocks of aligned vectors are aligned as well */
+  elements_per_thread = (elements_per_thread + MYLIB_PARTITION_ALIGN - 1) / MYLIB_PARTITION_ALIGN * MYLIB_PARTITION_ALIGN;
+
+  *begin = tcontrol->tid * elements_per_thread;
+  *end   = (tcontrol->tid + 1) * elements_per_thread;
+
+  if (*begin > size)
+    *begin = size;
+  if (*end > size)
+    *end = size;
 }
 
 /************** Part 2: Worker routines ****************/
 
 
+/* Arguments of the chunk routines. Each thread passes its own instance, so partial results are per thread. */
+typedef struct
+{
+  double *v1;
+  double *v2;
+  double *vresult;
+  double *v3;
+  double alpha;
+  double partial_result;
+  int partial_index;     /* location of partial_result for mylib_vector_iamax() */
+  int stream;            /* nonzero for non-temporal stores to vresult */
+} mylib_VectorChunkArgs;
+
+/* Arguments of the chunk routine of mylib_vector_mdot() */
+typedef struct
+{
+  double *x;
+  double **y;
+  int k;
+  double *partial_results;   /* k partial results of the executing thread */
+} mylib_MdotChunkArgs;
+
+/* Number of elements searched for the maximum at once by mylib_vector_iamax(). A block is scanned again for the index only if it raised the maximum. */
+#define MYLIB_IAMAX_BLOCK  1024
+
+/* Number of entries of x multiplied with all vectors y[j] by mylib_vector_mdot() before moving on, so that the block of x stays in the L1 cache */
+#define MYLIB_MDOT_BLOCK  1024
 
-/* Compute the sum of two vectors v1 and v2, store result in vector vresult. All vectors of length vsize. */
-int mylib_vector_add(mylib_ThreadControl tcontrol, double *v1, double *v2, double *vresult, int vsize)
+/* Maximum number of vectors y[j] handled in one pass of mylib_vector_mdot(). The partial results live on the stack, so no allocation happens per call. */
+#define MYLIB_MDOT_MAX_VECTORS  64
+
+/* Returns nonzero if an operation on num_vectors vectors of vsize doubles should write its result with non-temporal stores.
+ * Streaming pays off once the vectors do not fit into the last-level caches, since the result would be evicted before reuse anyway. */
+static int mylib_use_streaming(mylib_ThreadControl tcontrol, int vsize, int num_vectors)
+{
+  long threshold = tcontrol->shared_context->stream_threshold;
+
+  if (threshold == MYLIB_STREAM_AUTO)
+  {
+    long cache_bytes = mylib_topology_cache_bytes();
+
+    /* Unknown cache size: assume a large server cache rather than streaming too eagerly */
+    if (cache_bytes <= 0)
+      cache_bytes = 64L * 1024 * 1024;
+    threshold = cache_bytes / (num_vectors * (long)sizeof(double));
+  }
+
+  return vsize >= threshold;
+}
+
+/* Applies chunk to the entries [0, vsize) according to the 'schedule' of the ThreadFactory:
+ * the thread's static block for MYLIB_SCHEDULE_STATIC, stolen chunks for MYLIB_SCHEDULE_STEALING. */
+int mylib_apply(mylib_ThreadControl tcontrol, int vsize,
+                void (*chunk)(mylib_ThreadControl tcontrol, int begin, int end, void *arg), void *args)
 {
+  int begin_index, end_index;
+
+  if (tcontrol->shared_context->schedule == MYLIB_SCHEDULE_STEALING)
+    return mylib_ThreadControl_parallel_for(tcontrol, 0, vsize, tcontrol->shared_context->schedule_grain, chunk, args);
+
   /* Compute indices to split work equally over threads */
-  int i;
-  int elements_per_thread = (vsize - 1) / tcontrol->tsize + 1;
-  int begin_index = tcontrol->tid * elements_per_thread;
-  int end_index   = (tcontrol->tid + 1) * elements_per_thread;
+  mylib_partition(tcontrol, vsize, &begin_index, &end_index);
+  chunk(tcontrol, begin_index, end_index, args);
+
+  return MYLIB_SUCCESS;
+}
 
-  if (end_index > vsize)
-    end_index = vsize;
+/* Chunk routine of mylib_vector_add(). Large results bypass the caches. */
+static void mylib_vector_add_chunk(mylib_ThreadControl tcontrol, int begin_index, int end_index, void *data)
+{
+  mylib_VectorChunkArgs *args = (mylib_VectorChunkArgs *)data;
+  const mylib_Kernels *kernels = mylib_kernels();
+
+  (args->stream ? kernels->add_stream : kernels->add)(args->v1 + begin_index, args->v2 + begin_index, args->vresult + begin_index, end_index - begin_index);
+}
+
+/* Chunk routine of mylib_vector_dot(), accumulates into the partial result of the executing thread */
+static void mylib_vector_dot_chunk(mylib_ThreadControl tcontrol, int begin_index, int end_index, void *data)
+{
+  mylib_VectorChunkArgs *args = (mylib_VectorChunkArgs *)data;
+
+  args->partial_result += mylib_kernels()->dot(args->v1 + begin_index, args->v2 + begin_index, end_index - begin_index);
+}
+
+/* Chunk routine of mylib_vector_axpy() */
+static void mylib_vector_axpy_chunk(mylib_ThreadControl tcontrol, int begin_index, int end_index, void *data)
+{
+  mylib_VectorChunkArgs *args = (mylib_VectorChunkArgs *)data;
+
+  mylib_kernels()->axpy(args->alpha, args->v1 + begin_index, args->v2 + begin_index, end_index - begin_index);
+}
+
+/* Chunk routine of mylib_vector_scal() */
+static void mylib_vector_scal_chunk(mylib_ThreadControl tcontrol, int begin_index, int end_index, void *data)
+{
+  mylib_VectorChunkArgs *args = (mylib_VectorChunkArgs *)data;
+
+  mylib_kernels()->scal(args->alpha, args->v1 + begin_index, end_index - begin_index);
+}
+
+/* Chunk routine of mylib_vector_copy() */
+static void mylib_vector_copy_chunk(mylib_ThreadControl tcontrol, int begin_index, int end_index, void *data)
+{
+  mylib_VectorChunkArgs *args = (mylib_VectorChunkArgs *)data;
+
+  if (end_index > begin_index)
+    memcpy(args->v2 + begin_index, args->v1 + begin_index, (size_t)(end_index - begin_index) * sizeof(double));
+}
+
+/* Chunk routine of mylib_vector_swap() */
+static void mylib_vector_swap_chunk(mylib_ThreadControl tcontrol, int begin_index, int end_index, void *data)
+{
+  mylib_VectorChunkArgs *args = (mylib_VectorChunkArgs *)data;
+
+  mylib_kernels()->swap(args->v1 + begin_index, args->v2 + begin_index, end_index - begin_index);
+}
+
+/* Chunk routine of mylib_vector_asum() */
+static void mylib_vector_asum_chunk(mylib_ThreadControl tcontrol, int begin_index, int end_index, void *data)
+{
+  mylib_VectorChunkArgs *args = (mylib_VectorChunkArgs *)data;
+
+  args->partial_result += mylib_kernels()->asum(args->v1 + begin_index, end_index - begin_index);
+}
+
+/* Chunk routine of the overflow-safe path of mylib_vector_nrm2(): accumulates the squares of v1[i] / alpha */
+static void mylib_vector_nrm2_scaled_chunk(mylib_ThreadControl tcontrol, int begin_index, int end_index, void *data)
+{
+  mylib_VectorChunkArgs *args = (mylib_VectorChunkArgs *)data;
+  double result = 0;
+  int i;
 
-  /* Do the work */
   for (i = begin_index; i < end_index; ++i)
-    vresult[i] = v1[i] + v2[i];
+  {
+    double scaled = args->v1[i] / args->alpha;
+    result += scaled * scaled;
+  }
+
+  args->partial_result += result;
+}
+
+/* Chunk routine of mylib_vector_amax() and mylib_vector_nrm2() */
+static void mylib_vector_amax_chunk(mylib_ThreadControl tcontrol, int begin_index, int end_index, void *data)
+{
+  mylib_VectorChunkArgs *args = (mylib_VectorChunkArgs *)data;
+  double result = mylib_kernels()->amax(args->v1 + begin_index, end_index - begin_index);
+
+  if (result > args->partial_result)
+    args->partial_result = result;
+}
+
+/* Chunk routine of mylib_vector_iamax(). Chunks may be processed in any order, so ties go to the smaller index. */
+static void mylib_vector_iamax_chunk(mylib_ThreadControl tcontrol, int begin_index, int end_index, void *data)
+{
+  mylib_VectorChunkArgs *args = (mylib_VectorChunkArgs *)data;
+  const mylib_Kernels *kernels = mylib_kernels();
+  int block, i;
+
+  for (block = begin_index; block < end_index; block += MYLIB_IAMAX_BLOCK)
+  {
+    int n = (end_index - block < MYLIB_IAMAX_BLOCK) ? end_index - block : MYLIB_IAMAX_BLOCK;
+    double block_max = kernels->amax(args->v1 + block, n);
+
+    /* Skip blocks which do not raise the maximum. The negated comparison also skips NaN. */
+    if (!(block_max > args->partial_result || (block_max == args->partial_result && block < args->partial_index)))
+      continue;
+
+    /* The block is still in the L1 cache, find the first entry attaining the maximum */
+    for (i = block; i < block + n - 1 && fabs(args->v1[i]) != block_max; ++i)
+      ;
+    if (block_max > args->partial_result || i < args->partial_index)
+    {
+      args->partial_result = block_max;
+      args->partial_index  = i;
+    }
+  }
+}
+
+/* Chunk routine of mylib_vector_axpy_dot(), accumulates into the partial result of the executing thread */
+static void mylib_vector_axpy_dot_chunk(mylib_ThreadControl tcontrol, int begin_index, int end_index, void *data)
+{
+  mylib_VectorChunkArgs *args = (mylib_VectorChunkArgs *)data;
+
+  args->partial_result += mylib_kernels()->axpy_dot(args->alpha, args->v1 + begin_index, args->v2 + begin_index, args->v3 + begin_index, end_index - begin_index);
+}
+
+/* Chunk routine of mylib_vector_add_dot(), accumulates into the partial result of the executing thread */
+static void mylib_vector_add_dot_chunk(mylib_ThreadControl tcontrol, int begin_index, int end_index, void *data)
+{
+  mylib_VectorChunkArgs *args = (mylib_VectorChunkArgs *)data;
+
+  args->partial_result += mylib_kernels()->add_dot(args->v1 + begin_index, args->v2 + begin_index, args->vresult + begin_index, args->v3 + begin_index,
+                                                   end_index - begin_index);
+}
+
+/* Chunk routine of mylib_vector_mdot(), accumulates into the partial results of the executing thread */
+static void mylib_vector_mdot_chunk(mylib_ThreadControl tcontrol, int begin_index, int end_index, void *data)
+{
+  mylib_MdotChunkArgs *args = (mylib_MdotChunkArgs *)data;
+  const mylib_Kernels *kernels = mylib_kernels();
+  int block;
+
+  for (block = begin_index; block < end_index; block += MYLIB_MDOT_BLOCK)
+  {
+    int n = (end_index - block < MYLIB_MDOT_BLOCK) ? end_index - block : MYLIB_MDOT_BLOCK;
+
+    kernels->mdot(args->x + block, (const double *const *)args->y, args->k, block, n, args->partial_results);
+  }
+}
+
+/* Compute the sum of two vectors v1 and v2, store result in vector vresult. All vectors of length vsize. */
+int mylib_vector_add(mylib_ThreadControl tcontrol, double *v1, double *v2, double *vresult, int vsize)
+{
+  mylib_VectorChunkArgs args = {v1, v2, vresult, NULL, 0, 0, 0, mylib_use_streaming(tcontrol, vsize, 3)};
+
+  return mylib_apply(tcontrol, vsize, mylib_vector_add_chunk, &args);
 }
 
 /* Compute the dot product of two vectors v1 and v2, store result in dotresult. v1 and v2 of length vsize. */
 int mylib_vector_dot(mylib_ThreadControl tcontrol, double *v1, double *v2, double *dotresult, int vsize)
 {
-  /* Prepare thread-local data structures */
-  double *thread_results = NULL;
+  /* Partial result of each thread. Accumulated per chunk in a local struct, the team only sees the final value.
+   * With MYLIB_SCHEDULE_STEALING the chunks processed by a thread vary from call to call, hence the rounding of the result may vary as well. */
+  mylib_VectorChunkArgs args = {v1, v2, NULL, NULL, 0, 0, 0, 0};
+  double result;
+  int err = mylib_apply(tcontrol, vsize, mylib_vector_dot_chunk, &args);
 
-  mylib_ThreadControl_malloc(tcontrol, tcontrol->tsize * sizeof(double), (void**)&thread_results);
+  if (err)
+    return err;
 
-  thread_results[tcontrol->tid] = 0;
+  /* Combine partial results. The first thread writes 'dotresult' before any thread is released, so 'dotresult' is valid whenever any of the threads returns from the function */
+  return mylib_team_allreduce_double(tcontrol, args.partial_result, MYLIB_OP_SUM, &result, dotresult);
+}
 
-  /* Compute indices to split work equally over threads */
-  int i;
-  int elements_per_thread = (vsize - 1) / tcontrol->tsize + 1;
-  int begin_index = tcontrol->tid * elements_per_thread;
-  int end_index   = (tcontrol->tid + 1) * elements_per_thread;
+/* Compute y = alpha * x + y. x and y of length vsize. */
+int mylib_vector_axpy(mylib_ThreadControl tcontrol, double alpha, double *x, double *y, int vsize)
+{
+  mylib_VectorChunkArgs args = {x, y, NULL, NULL, alpha, 0, 0, 0};
 
-  if (end_index > vsize)
-    end_index = vsize;
+  return mylib_apply(tcontrol, vsize, mylib_vector_axpy_chunk, &args);
+}
 
-  /* Compute partial results for each thread */
-  for (i = begin_index; i < end_index; ++i)
-    thread_results[tcontrol->tid] += v1[i] * v2[i];
+/* Compute x = alpha * x. x of length vsize. */
+int mylib_vector_scal(mylib_ThreadControl tcontrol, double alpha, double *x, int vsize)
+{
+  mylib_VectorChunkArgs args = {x, NULL, NULL, NULL, alpha, 0, 0, 0};
+
+  return mylib_apply(tcontrol, vsize, mylib_vector_scal_chunk, &args);
+}
 
-  mylib_ThreadControl_sync(tcontrol);
+/* Copy x to y. x and y of length vsize, not overlapping. */
+int mylib_vector_copy(mylib_ThreadControl tcontrol, double *x, double *y, int vsize)
+{
+  mylib_VectorChunkArgs args = {x, y, NULL, NULL, 0, 0, 0, 0};
+
+  return mylib_apply(tcontrol, vsize, mylib_vector_copy_chunk, &args);
+}
+
+/* Exchange the entries of x and y. x and y of length vsize, not overlapping. */
+int mylib_vector_swap(mylib_ThreadControl tcontrol, double *x, double *y, int vsize)
+{
+  mylib_VectorChunkArgs args = {x, y, NULL, NULL, 0, 0, 0, 0};
+
+  return mylib_apply(tcontrol, vsize, mylib_vector_swap_chunk, &args);
+}
+
+/* Compute the sum of the absolute values of the entries of x, store result in asumresult. x of length vsize. */
+int mylib_vector_asum(mylib_ThreadControl tcontrol, double *x, double *asumresult, int vsize)
+{
+  mylib_VectorChunkArgs args = {x, NULL, NULL, NULL, 0, 0, 0, 0};
+  double result;
+  int err = mylib_apply(tcontrol, vsize, mylib_vector_asum_chunk, &args);
+
+  if (err)
+    return err;
+
+  return mylib_team_allreduce_double(tcontrol, args.partial_result, MYLIB_OP_SUM, &result, asumresult);
+}
+
+/* Compute the Euclidean norm of x, store result in nrm2result. x of length vsize. */
+int mylib_vector_nrm2(mylib_ThreadControl tcontrol, double *x, double *nrm2result, int vsize)
+{
+  mylib_VectorChunkArgs args = {x, x, NULL, NULL, 0, 0, 0, 0};
+  double result;
+  int err = mylib_apply(tcontrol, vsize, mylib_vector_dot_chunk, &args);
+
+  if (!err)
+    err = mylib_team_reduce(tcontrol, args.partial_result, 0, MYLIB_OP_SUM, &result, NULL);
+  if (err)
+    return err;
+
+  /* Fast path: the sum of squares neither overflowed nor lost accuracy to underflow. Otherwise thread 0 releases -1 to request the scaled computation. */
+  if (tcontrol->tid == 0)
+  {
+    result = (result >= DBL_MIN / DBL_EPSILON && result <= DBL_MAX) ? sqrt(result) : -1;
+    if (result >= 0)
+      *nrm2result = result;
+    mylib_team_release(tcontrol, result, 0);
+  }
+  if (result >= 0)
+    return MYLIB_SUCCESS;
+
+  /* Rare path: divide by the largest absolute value, so that the largest square is 1. Needs one pass for the maximum and one for the sum. */
+  args.partial_result = 0;
+  err = mylib_apply(tcontrol, vsize, mylib_vector_amax_chunk, &args);
+  if (!err)
+    err = mylib_team_allreduce_double(tcontrol, args.partial_result, MYLIB_OP_MAX, &args.alpha, NULL);
+  if (err)
+    return err;
+
+  args.partial_result = 0;
+  if (args.alpha > 0 && args.alpha <= DBL_MAX)
+    err = mylib_apply(tcontrol, vsize, mylib_vector_nrm2_scaled_chunk, &args);
+  if (!err)
+    err = mylib_team_reduce(tcontrol, args.partial_result, 0, MYLIB_OP_SUM, &result, NULL);
+  if (err)
+    return err;
 
-  /* Use first thread to sum up intermediate results */
   if (tcontrol->tid == 0)
   {
-    for (i = 1; i < tcontrol->tsize; ++i)
-      thread_results[0] += thread_results[i];
+    /* Zero vector, or an infinite entry */
+    result = (args.alpha > 0 && args.alpha <= DBL_MAX) ? args.alpha * sqrt(result) : args.alpha;
+    *nrm2result = result;
+    mylib_team_release(tcontrol, result, 0);
+  }
+
+  return MYLIB_SUCCESS;
+}
 
-    *dotresult = thread_results[0];
+/* Find the (zero-based) index of the first entry of x with the largest absolute value, store result in iamaxresult. -1 if vsize is 0. */
+int mylib_vector_iamax(mylib_ThreadControl tcontrol, double *x, int *iamaxresult, int vsize)
+{
+  /* Threads without entries contribute -1, which never wins against an absolute value */
+  mylib_VectorChunkArgs args = {x, NULL, NULL, NULL, 0, -1, vsize, 0};
+  double result;
+  int index;
+  int err = mylib_apply(tcontrol, vsize, mylib_vector_iamax_chunk, &args);
+
+  if (!err)
+    err = mylib_team_reduce(tcontrol, args.partial_result, args.partial_index, MYLIB_OP_MAXLOC, &result, &index);
+  if (err)
+    return err;
+
+  if (tcontrol->tid == 0)
+  {
+    *iamaxresult = (vsize > 0) ? index : -1;
+    mylib_team_release(tcontrol, result, index);
   }
 
-  /* Sync again to make sure 'dotresult' is valid whenever any of the threads returns from the function */
-  mylib_ThreadControl_sync(tcontrol);
+  return MYLIB_SUCCESS;
+}
+
+/* Compute y = alpha * x + y and the dot product of the updated y with z in a single pass, store the dot product in dotresult. All vectors of length vsize.
+ * z may be y, giving the squared norm of the updated y. */
+int mylib_vector_axpy_dot(mylib_ThreadControl tcontrol, double alpha, double *x, double *y, double *z, double *dotresult, int vsize)
+{
+  mylib_VectorChunkArgs args = {x, y, NULL, z, alpha, 0, 0, 0};
+  double result;
+  int err = mylib_apply(tcontrol, vsize, mylib_vector_axpy_dot_chunk, &args);
+
+  if (err)
+    return err;
+
+  return mylib_team_allreduce_double(tcontrol, args.partial_result, MYLIB_OP_SUM, &result, dotresult);
+}
+
+/* Compute the sum of two vectors v1 and v2, store result in vector vresult, and the dot product of vresult with v3 in a single pass,
+ * store the dot product in dotresult. All vectors of length vsize. v3 may be vresult, giving the squared norm of vresult. */
+int mylib_vector_add_dot(mylib_ThreadControl tcontrol, double *v1, double *v2, double *vresult, double *v3, double *dotresult, int vsize)
+{
+  mylib_VectorChunkArgs args = {v1, v2, vresult, v3, 0, 0, 0, 0};
+  double result;
+  int err = mylib_apply(tcontrol, vsize, mylib_vector_add_dot_chunk, &args);
+
+  if (err)
+    return err;
+
+  return mylib_team_allreduce_double(tcontrol, args.partial_result, MYLIB_OP_SUM, &result, dotresult);
+}
+
+/* Compute the dot products of x with the k vectors y[0], ..., y[k-1], store results in dotresults[0], ..., dotresults[k-1]. All vectors of length vsize.
+ * Blocks of x are multiplied with all y[j] while they reside in the L1 cache, and the k partial results are combined in a single team reduction. */
+int mylib_vector_mdot(mylib_ThreadControl tcontrol, double *x, double **y, int k, double *dotresults, int vsize)
+{
+  double partial_results[MYLIB_MDOT_MAX_VECTORS];
+  int first, j, err;
 
-  mylib_ThreadControl_free(tcontrol, thread_results);
+  if (k < 0)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
 
+  /* More than MYLIB_MDOT_MAX_VECTORS vectors take several passes over x */
+  for (first = 0; first < k; first += MYLIB_MDOT_MAX_VECTORS)
+  {
+    int count = (k - first < MYLIB_MDOT_MAX_VECTORS) ? k - first : MYLIB_MDOT_MAX_VECTORS;
+    mylib_MdotChunkArgs args = {x, y + first, count, partial_results};
+
+    for (j = 0; j < count; ++j)
+      partial_results[j] = 0;
+
+    err = mylib_apply(tcontrol, vsize, mylib_vector_mdot_chunk, &args);
+    if (!err)
+      err = mylib_team_reduce_array(tcontrol, partial_results, count, MYLIB_OP_SUM);
+    if (err)
+      return err;
+
+    /* As for mylib_vector_dot(), the results are written before any thread is released */
+    if (tcontrol->tid == 0)
+    {
+      memcpy(dotresults + first, partial_results, count * sizeof(double));
+      mylib_team_release(tcontrol, 0, 0);
+    }
+  }
+
+  return MYLIB_SUCCESS;
 }
 
 
+/* Single precision vectors are distributed in pairs of floats: blocks of MYLIB_SCHEDULE_STATIC are whole cache lines as for doubles,
+ * and match the placement of the pages by mylib_vector_alloc_float(). */
+
+/* Arguments of the single precision chunk routines. Each thread passes its own instance. */
+typedef struct
+{
+  float *v1;
+  float *v2;
+  float *vresult;
+  int vsize;
+  double partial_result;
+  int stream;            /* nonzero for non-temporal stores to vresult */
+} mylib_FloatChunkArgs;
+
+/* Returns the number of pairs of floats of a vector of vsize floats */
+static int mylib_float_pairs(int vsize)
+{
+  return vsize / 2 + vsize % 2;
+}
+
+/* Converts the range of pairs [begin_pair, end_pair) to the range of floats [*begin, *end) of a vector of vsize floats */
+static void mylib_float_range(int vsize, int begin_pair, int end_pair, int *begin, int *end)
+{
+  *begin = 2 * begin_pair;
+  *end   = (end_pair <= vsize / 2) ? 2 * end_pair : vsize;
+}
+
+/* Chunk routine of mylib_vector_add_float(). Large results bypass the caches. */
+static void mylib_vector_add_float_chunk(mylib_ThreadControl tcontrol, int begin_pair, int end_pair, void *data)
+{
+  mylib_FloatChunkArgs *args = (mylib_FloatChunkArgs *)data;
+  const mylib_Kernels *kernels = mylib_kernels();
+  int begin_index, end_index;
+
+  mylib_float_range(args->vsize, begin_pair, end_pair, &begin_index, &end_index);
+  if (begin_index < end_index)
+    (args->stream ? kernels->add_stream_float : kernels->add_float)(args->v1 + begin_index, args->v2 + begin_index, args->vresult + begin_index,
+                                                                     end_index - begin_index);
+}
+
+/* Chunk routine of mylib_vector_dot_float(), accumulates into the partial result of the executing thread */
+static void mylib_vector_dot_float_chunk(mylib_ThreadControl tcontrol, int begin_pair, int end_pair, void *data)
+{
+  mylib_FloatChunkArgs *args = (mylib_FloatChunkArgs *)data;
+  int begin_index, end_index;
+
+  mylib_float_range(args->vsize, begin_pair, end_pair, &begin_index, &end_index);
+  if (begin_index < end_index)
+    args->partial_result += mylib_kernels()->dot_float(args->v1 + begin_index, args->v2 + begin_index, end_index - begin_index);
+}
+
+/* Chunk routine of mylib_vector_dsdot(), accumulates into the partial result of the executing thread */
+static void mylib_vector_dsdot_chunk(mylib_ThreadControl tcontrol, int begin_pair, int end_pair, void *data)
+{
+  mylib_FloatChunkArgs *args = (mylib_FloatChunkArgs *)data;
+  int begin_index, end_index;
+
+  mylib_float_range(args->vsize, begin_pair, end_pair, &begin_index, &end_index);
+  if (begin_index < end_index)
+    args->partial_result += mylib_kernels()->dsdot(args->v1 + begin_index, args->v2 + begin_index, end_index - begin_index);
+}
+
+/* Compute the sum of two single precision vectors v1 and v2, store result in vector vresult. All vectors of length vsize. */
+int mylib_vector_add_float(mylib_ThreadControl tcontrol, float *v1, float *v2, float *vresult, int vsize)
+{
+  /* A pair of floats has the size of a double, so the streaming threshold applies to the number of pairs */
+  mylib_FloatChunkArgs args = {v1, v2, vresult, vsize, 0, mylib_use_streaming(tcontrol, mylib_float_pairs(vsize), 3)};
+
+  return mylib_apply(tcontrol, mylib_float_pairs(vsize), mylib_vector_add_float_chunk, &args);
+}
+
+/* Compute the dot product of two single precision vectors v1 and v2, store result in dotresult. v1 and v2 of length vsize. */
+int mylib_vector_dot_float(mylib_ThreadControl tcontrol, float *v1, float *v2, float *dotresult, int vsize)
+{
+  mylib_FloatChunkArgs args = {v1, v2, NULL, vsize, 0, 0};
+  double result;
+  int err = mylib_apply(tcontrol, mylib_float_pairs(vsize), mylib_vector_dot_float_chunk, &args);
+
+  if (!err)
+    err = mylib_team_reduce(tcontrol, args.partial_result, 0, MYLIB_OP_SUM, &result, NULL);
+  if (err)
+    return err;
+
+  /* The result is rounded to single precision once, by thread 0 before any thread is released */
+  if (tcontrol->tid == 0)
+  {
+    *dotresult = (float)result;
+    mylib_team_release(tcontrol, result, 0);
+  }
+
+  return MYLIB_SUCCESS;
+}
+
+/* Compute the dot product of two single precision vectors v1 and v2 in double precision, store result in dotresult. v1 and v2 of length vsize. */
+int mylib_vector_dsdot(mylib_ThreadControl tcontrol, float *v1, float *v2, double *dotresult, int vsize)
+{
+  mylib_FloatChunkArgs args = {v1, v2, NULL, vsize, 0, 0};
+  double result;
+  int err = mylib_apply(tcontrol, mylib_float_pairs(vsize), mylib_vector_dsdot_chunk, &args);
+
+  if (err)
+    return err;
+
+  return mylib_team_allreduce_double(tcontrol, args.partial_result, MYLIB_OP_SUM, &result, dotresult);
+}
@@ -1,15 +1,72 @@
+#ifndef MYLIB_H
+#define MYLIB_H
 
+/* Error codes returned by mylib routines. Zero indicates success. */
+#define MYLIB_SUCCESS                 0
+#define MYLIB_ERROR_OUT_OF_MEMORY     1
+#define MYLIB_ERROR_INVALID_ARGUMENT  2
+#define MYLIB_ERROR_NOT_SUPPORTED     3
+
+/* Reduction operations for team collectives */
+#define MYLIB_OP_SUM  0
+#define MYLIB_OP_MIN  1
+#define MYLIB_OP_MAX  2
+
+/* Maximum number of bytes per thread exchanged by mylib_ThreadControl_bcast() and mylib_ThreadControl_gather() */
+#define MYLIB_COLLECTIVE_MAX_BYTES  256
+
+/* Work distribution of the worker routines */
+#define MYLIB_SCHEDULE_STATIC    0   /* thread tid processes the tid-th contiguous block: deterministic placement, no scheduling overhead */
+#define MYLIB_SCHEDULE_STEALING  1   /* ranges are split into chunks, idle threads steal chunks from busy threads */
+
+/* Operation on dense matrices */
+#define MYLIB_MATRIX_NOTRANS  0   /* use A */
+#define MYLIB_MATRIX_TRANS    1   /* use the transpose of A */
+
+/* Value of 'stream_threshold' of the ThreadFactory: stream once the vectors of an operation no longer fit into the last-level caches */
+#define MYLIB_STREAM_AUTO  -1
+
+/* Largest chunk height of a matrix in SELL-C-sigma format */
+#define MYLIB_SELL_MAX_CHUNK_HEIGHT  64
+
+/* Thread placement policies for mylib_ThreadControl_pin() and mylib_ThreadFactory_pin_pool() */
+#define MYLIB_PLACEMENT_NONE     0   /* do not pin, only record the current core and node */
+#define MYLIB_PLACEMENT_COMPACT  1   /* consecutive threads on neighboring hardware threads: fill a core, then a package, then a NUMA node */
+#define MYLIB_PLACEMENT_SCATTER  2   /* consecutive threads round-robin over NUMA nodes, one thread per core before using hyperthreads */
+
+/* Page placement policies for mylib_vector_alloc() */
+#define MYLIB_MEMORY_FIRST_TOUCH  0   /* each page is placed on the node of the thread which processes it in the worker routines */
+#define MYLIB_MEMORY_INTERLEAVE   1   /* pages are interleaved round-robin over all NUMA nodes */
+#define MYLIB_MEMORY_BIND         2   /* like MYLIB_MEMORY_FIRST_TOUCH, but pages are explicitly bound to the 'node' of the thread. Requires pinned threads */
+#define MYLIB_MEMORY_HUGEPAGES    4   /* flag: back the vector with transparent huge pages via madvise(MADV_HUGEPAGE) */
+#define MYLIB_MEMORY_HUGETLB      8   /* flag: back the vector with explicit huge pages via MAP_HUGETLB, transparent huge pages if none are available */
 
 /************** Part 1: Thread Control and Management ****************/
 
+/* Per-team state (collectives, shared buffers) and persistent worker pool, managed by mylib */
+struct mylib_TeamEntry_s;
+struct mylib_Pool_s;
+
 /* Thread factory struct. In a real-world implementation this struct should not be exposed publicly, but provided as an opaque pointer. */
 typedef struct
 {
   /* function pointers for synchronization, etc. */
   void (*sync)(int tid, int size, void *data);                        /* thread synchronization function */
   void *sync_data;                                 /* Optional user-provided auxiliary data passed to sync */
+  int  (*arrive)(int tid, int size, void *data);             /* Optional split-phase synchronization: signals arrival, returns a token for wait */
+  void (*wait)(int tid, int size, void *data, int token);    /* Optional split-phase synchronization: returns once all threads arrived at token */
+  void (*sync_data_destroy)(void *data);           /* Releases sync_data in mylib_ThreadFactory_destroy(). NULL for user-owned sync_data */
+  long sync_spin_count;                            /* Built-in hybrid barrier: busy-wait iterations before a waiting thread parks */
+  long sync_spin_ns;                               /* Built-in hybrid barrier: busy-wait time in nanoseconds before a waiting thread parks. 0 for no time limit */
 
-  void *shared_data; /* pointer for exchanging data across threads */
+  struct mylib_TeamEntry_s *teams; /* per-team state of collectives and mylib_ThreadControl_malloc(), indexed by the 'team' member of the thread control */
+  int num_teams;              /* number of teams. Team 0 always exists and synchronizes via sync_data */
+  struct mylib_Pool_s *pool;  /* persistent worker threads, only for factories created by mylib_ThreadFactory_create_pool() */
+
+  int schedule;               /* work distribution of the worker routines, MYLIB_SCHEDULE_STATIC (default) or MYLIB_SCHEDULE_STEALING */
+  int schedule_grain;         /* MYLIB_SCHEDULE_STEALING: ranges are not split below this number of elements */
+  long stream_threshold;      /* result vectors of at least this many elements are written with non-temporal stores, bypassing the caches.
+                                 MYLIB_STREAM_AUTO (default) derives the threshold from the cache size, 0 always streams, LONG_MAX never streams */
 
   /* A full-fledged implementation requires a bunch of other callbacks.
    * For illustration purposes, however, we will only consider a sync() method here. */
@@ -26,6 +83,19 @@ typedef struct
   /* thread layout information */
   int tid;              /* thread ID */
   int tsize;            /* total number of threads */
+  int team;             /* team ID obtained from mylib_ThreadFactory_create_team(). 0 (default) for the factory's default team */
+
+  /* placement information, set by mylib_ThreadControl_pin(). -1 if unknown */
+  int core;             /* core the thread runs on (dense index over all packages) */
+  int node;             /* NUMA node the thread runs on */
+
+  /* split-phase synchronization state */
+  int sync_pending;     /* nonzero if this thread arrived at a synchronization point, but did not wait for its completion yet */
+  int sync_token;       /* token of the pending synchronization point */
+
+  /* position of the next mylib_ThreadControl_malloc() in the factory's arena. Identical on all threads, since all threads allocate in the same order */
+  int  arena_block;
+  long arena_offset;
 
   mylib_ThreadFactory shared_context;
 
@@ -35,36 +105,303 @@ typedef struct
 extern "C" {
 #endif
 
+/* Reports the number of hardware threads the process may run on, and the number of cores and NUMA nodes they belong to. Each argument may be NULL. */
+int mylib_get_topology(int *num_cpus, int *num_cores, int *num_nodes);
+
 /* Creates an empty ThreadFactory object. */
 int mylib_ThreadFactory_create(mylib_ThreadFactory *tfactory);
 
+/* Creates a ThreadFactory object using mylib's built-in sense-reversing spin barrier for a team of num_threads threads.
+ * No user-provided sync callback is needed. Best suited for teams with at most one thread per core. */
+int mylib_ThreadFactory_create_spin(mylib_ThreadFactory *tfactory, int num_threads);
+
+/* Creates a ThreadFactory object using mylib's built-in hybrid barrier for a team of num_threads threads.
+ * Waiting threads busy-wait until the spin budget in sync_spin_count and sync_spin_ns is exhausted, then park on a futex (Linux) or yield (elsewhere).
+ * Suited for teams which may be oversubscribed. The spin budget can be adjusted at any time. */
+int mylib_ThreadFactory_create_hybrid(mylib_ThreadFactory *tfactory, int num_threads);
+
+/* Creates a ThreadFactory object using mylib's built-in dissemination barrier for a team of num_threads threads.
+ * Completes in ceil(log2(num_threads)) rounds of pairwise signals, each thread only spins on flags in its own cache lines. */
+int mylib_ThreadFactory_create_dissemination(mylib_ThreadFactory *tfactory, int num_threads);
+
+/* Creates a ThreadFactory object using mylib's built-in tournament barrier for a team of num_threads threads.
+ * Arrival and wake-up propagate along a binary tree, each thread only spins on flags in its own cache lines. */
+int mylib_ThreadFactory_create_tournament(mylib_ThreadFactory *tfactory, int num_threads);
+
+/* Creates a ThreadFactory object using the built-in barrier best suited for a team of num_threads threads:
+ * the central spin barrier for small teams, the dissemination or tournament barrier for large teams. */
+int mylib_ThreadFactory_create_auto(mylib_ThreadFactory *tfactory, int num_threads);
+
+/* Creates a ThreadFactory object owning a pool of num_threads-1 persistent worker threads, which are parked between calls to mylib_run().
+ * Uses mylib's built-in hybrid barrier, so idle workers do not occupy cores. */
+int mylib_ThreadFactory_create_pool(mylib_ThreadFactory *tfactory, int num_threads);
+
+/* Pins all threads of a pool-backed ThreadFactory according to placement (MYLIB_PLACEMENT_*) and records core and node in their thread control objects.
+ * The calling thread is pinned as thread 0, i.e. this should be called from the thread which subsequently calls mylib_run().
+ * Returns the error of mylib_ThreadControl_pin() if pinning fails on any thread; the threads which could not be pinned have core and node -1. */
+int mylib_ThreadFactory_pin_pool(mylib_ThreadFactory tfactory, int placement);
+
+/* Reports how many barrier waits were resolved while busy-waiting and how many had to park since the factory was created.
+ * Only available for built-in barriers, returns MYLIB_ERROR_NOT_SUPPORTED for user-provided sync callbacks. */
+int mylib_ThreadFactory_get_sync_stats(mylib_ThreadFactory tfactory, long *spin_waits, long *parked_waits);
+
 /* Destroys a ThreadFactory object. */
 int mylib_ThreadFactory_destroy(mylib_ThreadFactory tfactory);
 
+/* Adds a team of num_threads threads to the factory and returns its ID in *team. Threads of the team set 'team' in their thread control objects.
+ * Teams have separate synchronization and separate state for collectives and shared buffers, so that they can run mylib operations concurrently.
+ * For factories with a built-in barrier, pass sync_data NULL to create a barrier of the same kind for the new team.
+ * For user-provided sync callbacks, sync_data is passed to the callback for this team (e.g. a separate pthread_barrier_t).
+ * Not thread-safe: teams are to be created before any thread uses the factory. */
+int mylib_ThreadFactory_create_team(mylib_ThreadFactory tfactory, int num_threads, void *sync_data, int *team);
+
 /* Factory function for creating an empty ThreadControl object. */
 int mylib_ThreadFactory_create_control(mylib_ThreadFactory tfactory, mylib_ThreadControl *tcontrol);
 
-/* Factory function for creating an empty ThreadControl object. */
+/* Returns the thread control object of thread tid of the given team (0 for the default team) with team size tsize.
+ * The objects are owned by the factory and reused across calls, so that no allocation happens per operation.
+ * Calls for different tids may happen concurrently. The object must not be destroyed by the caller. */
+int mylib_ThreadFactory_get_control(mylib_ThreadFactory tfactory, int team, int tid, int tsize, mylib_ThreadControl *tcontrol);
+
+/* Destroys a ThreadControl object. Completes a pending split-phase synchronization of the thread. */
 int mylib_ThreadFactory_destroy_control(mylib_ThreadFactory tfactory, mylib_ThreadControl tcontrol);
 
-/* Allocates a shared buffer for all threads in tcontrol. */
+/* Assigns a new thread ID and team size to tcontrol without reallocating it, e.g. when a thread joins a team of a different size.
+ * Completes a pending split-phase synchronization of the old team. All buffers of mylib_ThreadControl_malloc() must have been released. */
+int mylib_ThreadControl_rebind(mylib_ThreadControl tcontrol, int tid, int tsize);
+
+/* Allocates a shared buffer for all threads in tcontrol. Must be called by all threads with the same num_bytes.
+ * The buffer is taken from the factory's arena and aligned to a cache line. Since all threads advance their position in the arena in the same way,
+ * no synchronization is needed unless the arena has to grow. The buffer is uninitialized, i.e. threads must synchronize after writing to it.
+ * Buffers are released in reverse order of allocation, and before the thread control objects are destroyed. */
 int mylib_ThreadControl_malloc(mylib_ThreadControl tcontrol, int num_bytes, void **ptr);
 
-/* Frees a shared buffer allocated for all threads in tcontrol .*/
+/* Frees a shared buffer allocated for all threads in tcontrol, together with all buffers allocated after it.
+ * The memory is reused only once all threads called mylib_ThreadControl_free(). */
 int mylib_ThreadControl_free(mylib_ThreadControl tcontrol, void *ptr);
 
 /* Synchronizes all threads in tcontrol (i.e. no thread proceeds before all threads have reached this point) */
 int mylib_ThreadControl_sync(mylib_ThreadControl tcontrol);
 
+/* Returns per-thread scratch of at least num_bytes bytes for each thread in tcontrol. Must be called by all threads with the same num_bytes.
+ * The slot of thread t starts at (char *)*scratch + t * *stride. Slots are aligned to and padded to a multiple of the cache line size,
+ * so threads writing to their own slot do not slow down each other (no false sharing). Accumulate in local variables and write to the slot once.
+ * The scratch is shared by all callers and remains valid until the team changes or a call requests more bytes. */
+int mylib_ThreadControl_scratch(mylib_ThreadControl tcontrol, int num_bytes, void **scratch, int *stride);
+
+/* Pins the calling thread to a hardware thread according to its tid and the placement policy (MYLIB_PLACEMENT_*),
+ * and records the core and NUMA node in tcontrol. Placement is based on the topology in /sys/devices/system/cpu and /sys/devices/system/node,
+ * restricted to the cpus the process may run on. Threads wrap around if there are more threads than cpus. Linux only.
+ * If the affinity cannot be set, MYLIB_ERROR_NOT_SUPPORTED is returned and core and node are set to -1. */
+int mylib_ThreadControl_pin(mylib_ThreadControl tcontrol, int placement);
+
+/* Split-phase synchronization, first half: Signals that the calling thread has reached a synchronization point, but does not wait for the other threads.
+ * The returned token identifies the synchronization point for mylib_ThreadControl_wait(). Work not depending on the other threads can be done in between.
+ * If the previous synchronization point of the calling thread has not been waited for yet, this is done first.
+ * Uses the arrive/wait callbacks of the ThreadFactory if available, otherwise falls back to a full sync. */
+int mylib_ThreadControl_arrive(mylib_ThreadControl tcontrol, int *token);
+
+/* Split-phase synchronization, second half: Returns once all threads in tcontrol arrived at the synchronization point identified by token. */
+int mylib_ThreadControl_wait(mylib_ThreadControl tcontrol, int token);
+
+/* Combines 'value' of all threads in tcontrol with the reduction operation op (MYLIB_OP_SUM, MYLIB_OP_MIN, MYLIB_OP_MAX) and returns the result to all threads.
+ * Partial results are combined along a binary tree in preallocated, cache-line-padded slots: no heap allocation, no call to the sync routine, O(log(tsize)) steps.
+ * The result is bitwise identical on all threads and reproducible for a fixed number of threads. */
+int mylib_ThreadControl_allreduce_double(mylib_ThreadControl tcontrol, double value, int op, double *result);
+
+/* Copies num_bytes bytes from buffer of thread root to buffer of all other threads in tcontrol.
+ * Uses preallocated per-team scratch (at most MYLIB_COLLECTIVE_MAX_BYTES bytes) and a single split-phase synchronization, which the root does not wait for. */
+int mylib_ThreadControl_bcast(mylib_ThreadControl tcontrol, void *buffer, int num_bytes, int root);
+
+/* Collects num_bytes bytes from sendbuf of each thread in tcontrol into recvbuf of thread root, ordered by thread ID (recvbuf holds tsize * num_bytes bytes).
+ * Uses preallocated per-team scratch (at most MYLIB_COLLECTIVE_MAX_BYTES bytes per thread) and a single split-phase synchronization, which only the root waits for. */
+int mylib_ThreadControl_gather(mylib_ThreadControl tcontrol, const void *sendbuf, int num_bytes, void *recvbuf, int root);
+
+/* Runs fn(tcontrol, arg) on all num_threads threads of a pool-backed ThreadFactory and returns once all threads completed.
+ * The calling thread participates as thread 0. tcontrol carries tid and tsize as for user-managed threads, so fn can call any mylib routine.
+ * Only one mylib_run() per factory may be active at a time. Returns MYLIB_ERROR_NOT_SUPPORTED for factories without pool. */
+int mylib_run(mylib_ThreadFactory tfactory, void (*fn)(mylib_ThreadControl tcontrol, void *arg), void *arg);
+
+/* Executes body(tcontrol, chunk_begin, chunk_end, arg) for chunks covering the range [begin, end) using a work-stealing scheduler.
+ * Must be called by all threads in tcontrol with the same begin, end, and grain. Each thread starts with its static block and splits it into halves
+ * down to 'grain' elements, stored in a per-thread Chase-Lev deque. Threads running out of work steal chunks from the deques of other threads.
+ * Like the static blocks, chunks start at multiples of a cache line of doubles from begin, so chunks of different threads do not share cache lines.
+ * body is called with the tcontrol and arg of the executing thread, i.e. per-thread accumulators can be passed via arg. Synchronizes once on entry. */
+int mylib_ThreadControl_parallel_for(mylib_ThreadControl tcontrol, int begin, int end, int grain,
+                                     void (*body)(mylib_ThreadControl tcontrol, int begin, int end, void *arg), void *arg);
+
 
 /************** Part 2: Worker routines ****************/
 
+/* The worker routines split the vectors according to the 'schedule' of the ThreadFactory. */
+
+/* Allocates a vector of vsize doubles, initialized to zero, and returns it to all threads in tcontrol.
+ * Each thread writes the entries it processes in the worker routines (see mylib_vector_partition()), so that with the default first-touch policy of the
+ * operating system their pages are placed on the thread's NUMA node. 'policy' (MYLIB_MEMORY_*) additionally requests an explicit placement via mbind(),
+ * optionally combined with MYLIB_MEMORY_HUGEPAGES or MYLIB_MEMORY_HUGETLB to reduce TLB misses on large vectors.
+ * The vector is aligned to a page, and hence to a cache line. Explicit placement and huge pages are hints and silently fall back to first touch and regular pages. */
+int mylib_vector_alloc(mylib_ThreadControl tcontrol, int vsize, int policy, double **v);
+
+/* Releases a vector obtained from mylib_vector_alloc(). Must be called by a single thread only, after all threads are done with the vector. */
+void mylib_vector_free(double *v);
+
+/* Returns the range [*begin, *end) of the entries of a vector of length vsize which the calling thread processes with MYLIB_SCHEDULE_STATIC.
+ * Initializing vectors with the same partition keeps the pages on the NUMA node of the thread using them. */
+int mylib_vector_partition(mylib_ThreadControl tcontrol, int vsize, int *begin, int *end);
+
 /* Compute the sum of two vectors v1 and v2, store result in vector vresult. All vectors of length vsize. */
 int mylib_vector_add(mylib_ThreadControl tcontrol, double *v1, double *v2, double *vresult, int vsize);
 
 /* Compute the dot product of two vectors v1 and v2, store result in dotresult. v1 and v2 of length vsize. */
 int mylib_vector_dot(mylib_ThreadControl tcontrol, double *v1, double *v2, double *dotresult, int vsize);
 
+/* BLAS level-1 operations. Like mylib_vector_add(), the routines updating vectors do not synchronize on return.
+ * Like mylib_vector_dot(), the reductions combine the partial results of the threads in a team allreduce, and their result is stored by thread 0
+ * before any thread returns, so it is valid whenever any of the threads returns from the function. */
+
+/* Compute y = alpha * x + y. x and y of length vsize. */
+int mylib_vector_axpy(mylib_ThreadControl tcontrol, double alpha, double *x, double *y, int vsize);
+
+/* Compute x = alpha * x. x of length vsize. */
+int mylib_vector_scal(mylib_ThreadControl tcontrol, double alpha, double *x, int vsize);
+
+/* Copy x to y. x and y of length vsize, not overlapping. */
+int mylib_vector_copy(mylib_ThreadControl tcontrol, double *x, double *y, int vsize);
+
+/* Exchange the entries of x and y. x and y of length vsize, not overlapping. */
+int mylib_vector_swap(mylib_ThreadControl tcontrol, double *x, double *y, int vsize);
+
+/* Compute the Euclidean norm of x, store result in nrm2result. x of length vsize.
+ * Takes a single pass unless the sum of squares over- or underflows, in which case the entries are rescaled in two additional passes. */
+int mylib_vector_nrm2(mylib_ThreadControl tcontrol, double *x, double *nrm2result, int vsize);
+
+/* Compute the sum of the absolute values of the entries of x, store result in asumresult. x of length vsize. */
+int mylib_vector_asum(mylib_ThreadControl tcontrol, double *x, double *asumresult, int vsize);
+
+/* Find the index of the first entry of x with the largest absolute value, store result in iamaxresult. x of length vsize.
+ * Unlike the Fortran BLAS, the index is zero-based. -1 if vsize is 0. */
+int mylib_vector_iamax(mylib_ThreadControl tcontrol, double *x, int *iamaxresult, int vsize);
+
+/* Fused operations for iterative solvers, which update a vector and reduce over the result in a single pass over memory and a single team reduction,
+ * instead of a separate update and mylib_vector_dot(). The dot product is stored like the one of mylib_vector_dot(). */
+
+/* Compute y = alpha * x + y and the dot product of the updated y with z, store the dot product in dotresult. All vectors of length vsize.
+ * z may be y, giving the squared norm of the updated y. */
+int mylib_vector_axpy_dot(mylib_ThreadControl tcontrol, double alpha, double *x, double *y, double *z, double *dotresult, int vsize);
+
+/* Compute the sum of two vectors v1 and v2, store result in vector vresult, and the dot product of vresult with v3, store it in dotresult.
+ * All vectors of length vsize. v3 may be vresult, giving the squared norm of vresult. */
+int mylib_vector_add_dot(mylib_ThreadControl tcontrol, double *v1, double *v2, double *vresult, double *v3, double *dotresult, int vsize);
+
+/* Compute the dot products of x with the k vectors y[0], ..., y[k-1], store results in dotresults[0], ..., dotresults[k-1]. All vectors of length vsize.
+ * Takes a single pass over memory, in which blocks of x stay in the cache while they are multiplied with all y[j], and a single team reduction of all k values
+ * (for k up to 64; larger k are processed in groups of 64). The results are stored like the one of mylib_vector_dot(). */
+int mylib_vector_mdot(mylib_ThreadControl tcontrol, double *x, double **y, int k, double *dotresults, int vsize);
+
+/* Single precision vectors move half the bytes of double precision ones. The threads split them like double vectors of half the length,
+ * i.e. in blocks of whole cache lines, and the schedule and streaming stores of the double precision routines apply. */
+
+/* Allocates a vector of vsize floats, initialized to zero, and returns it to all threads in tcontrol. Pages are placed as by mylib_vector_alloc(). */
+int mylib_vector_alloc_float(mylib_ThreadControl tcontrol, int vsize, int policy, float **v);
+
+/* Releases a vector obtained from mylib_vector_alloc_float(). Must be called by a single thread only, after all threads are done with the vector. */
+void mylib_vector_free_float(float *v);
+
+/* Compute the sum of two single precision vectors v1 and v2, store result in vector vresult. All vectors of length vsize. */
+int mylib_vector_add_float(mylib_ThreadControl tcontrol, float *v1, float *v2, float *vresult, int vsize);
+
+/* Compute the dot product of two single precision vectors v1 and v2, store result in dotresult. v1 and v2 of length vsize.
+ * Products are summed up in single precision within the chunks of a thread, the partial sums of the chunks and threads in double precision. */
+int mylib_vector_dot_float(mylib_ThreadControl tcontrol, float *v1, float *v2, float *dotresult, int vsize);
+
+/* Compute the dot product of two single precision vectors v1 and v2 in double precision, store result in dotresult. v1 and v2 of length vsize.
+ * Like the BLAS dsdot, the entries are converted to double before they are multiplied, so the result is as accurate as mylib_vector_dot() on the same values
+ * at half the memory traffic. */
+int mylib_vector_dsdot(mylib_ThreadControl tcontrol, float *v1, float *v2, double *dotresult, int vsize);
+
+
+/* Dense matrices are stored row-major: entry (i, j) of A is A[i * lda + j], with leading dimension lda >= number of columns. */
+
+/* Compute y = alpha * op(A) * x + beta * y, where op(A) is the m-by-n matrix A for MYLIB_MATRIX_NOTRANS, or its transpose for MYLIB_MATRIX_TRANS.
+ * Rows of A are split across the threads in tcontrol. Without transpose each thread computes the entries of y for its rows; with transpose the
+ * threads accumulate column partials of their rows, which are then summed up by column ranges (one sync, no atomics) using a buffer from
+ * mylib_ThreadControl_malloc(), and MYLIB_ERROR_OUT_OF_MEMORY is returned if the partials of all threads exceed INT_MAX bytes.
+ * y is not read if beta is zero. Like mylib_vector_add(), the routine does not synchronize on return. */
+int mylib_matrix_gemv(mylib_ThreadControl tcontrol, int trans, int m, int n, double alpha, double *A, int lda, double *x, double beta, double *y);
+
+/* Compute C = alpha * op(A) * op(B) + beta * C, where op(A) is m-by-k, op(B) is k-by-n, and C is m-by-n. transa and transb are MYLIB_MATRIX_NOTRANS or MYLIB_MATRIX_TRANS.
+ * The threads in tcontrol are arranged in a grid over C and each computes a rectangular region of C. A thread packs the blocks of A for its rows
+ * into the L2 cache, the threads of a column of the grid pack each block of B for their columns together and share it in the L3 cache,
+ * synchronizing twice per block. The packed blocks are multiplied with a register-blocked SIMD kernel.
+ * Packing buffers are taken from mylib_ThreadControl_malloc(), so all threads in tcontrol must call the routine. C is not read if beta is zero. Like mylib_vector_add(), the routine does not synchronize on return. */
+int mylib_matrix_gemm(mylib_ThreadControl tcontrol, int transa, int transb, int m, int n, int k,
+                      double alpha, double *A, int lda, double *B, int ldb, double beta, double *C, int ldc);
+
+
+/* Sparse matrices are stored in compressed sparse row (CSR) format: the nonzeros of row i are values[row_ptr[i]] ... values[row_ptr[i + 1] - 1],
+ * in the columns col_idx[row_ptr[i]] ... col_idx[row_ptr[i + 1] - 1]. */
+
+/* Partition of the rows of a CSR matrix over the threads of a team, managed by mylib */
+typedef struct mylib_CsrPlan_s *mylib_CsrPlan;
+
+/* Creates a plan for the m-by-n CSR matrix (row_ptr, col_idx, values) and a team of num_threads threads. Must be called by a single thread only.
+ * The rows are split into contiguous ranges of about the same number of nonzeros (plus one per row), rather than of rows, so that threads are balanced
+ * for matrices with irregular rows. The plan keeps pointers to the arrays: the values may change between calls, the sparsity pattern must not. */
+int mylib_CsrPlan_create(mylib_CsrPlan *plan, int num_threads, int m, int n, const int *row_ptr, const int *col_idx, const double *values);
+
+/* Destroys a plan created by mylib_CsrPlan_create(). Must be called by a single thread only, after all threads are done with the plan. */
+int mylib_CsrPlan_destroy(mylib_CsrPlan plan);
+
+/* Compute y = alpha * A * x + beta * y for the CSR matrix A of the plan. The team size of tcontrol must match the plan.
+ * Each thread computes the entries of y for its rows in the plan, independent of the 'schedule' of the ThreadFactory. A single row is never split.
+ * y is not read if beta is zero. Like mylib_vector_add(), the routine does not synchronize on return. */
+int mylib_csr_spmv(mylib_ThreadControl tcontrol, mylib_CsrPlan plan, double alpha, double *x, double beta, double *y);
+
+/* Sparse matrix in SELL-C-sigma format (sliced ELLPACK), managed by mylib. Chunks of c rows are padded to their longest row and stored column by column,
+ * so that a SIMD kernel processes c rows at once. Rows are sorted by decreasing length within windows of sigma rows, which reduces the padding. */
+typedef struct mylib_SellMatrix_s *mylib_SellMatrix;
+
+/* Converts the m-by-n CSR matrix (row_ptr, col_idx, values) into SELL-C-sigma format with chunk height c (1 to MYLIB_SELL_MAX_CHUNK_HEIGHT) and sorting window sigma.
+ * c = 8 fills AVX-512 vectors and two AVX2 vectors. sigma = 1 keeps the order of the rows; a few hundred rows usually remove most of the padding while keeping
+ * the accesses to x local. The chunks are split into contiguous ranges of about the same number of stored entries for a team of num_threads threads, as in
+ * mylib_CsrPlan_create(). The matrix holds a copy of the values, i.e. it has to be recreated if they change. Must be called by a single thread only. */
+int mylib_SellMatrix_create(mylib_SellMatrix *sell, int num_threads, int c, int sigma, int m, int n, const int *row_ptr, const int *col_idx, const double *values);
+
+/* Destroys a matrix created by mylib_SellMatrix_create(). Must be called by a single thread only, after all threads are done with the matrix. */
+int mylib_SellMatrix_destroy(mylib_SellMatrix sell);
+
+/* Compute y = alpha * A * x + beta * y for the SELL-C-sigma matrix A. With MYLIB_SCHEDULE_STATIC, each thread computes its chunks of the split of the matrix,
+ * and the team size of tcontrol must match the matrix. With MYLIB_SCHEDULE_STEALING, idle threads steal chunks from busy threads.
+ * x and y are in the original order of the rows. y is not read if beta is zero. Like mylib_vector_add(), the routine does not synchronize on return. */
+int mylib_sell_spmv(mylib_ThreadControl tcontrol, mylib_SellMatrix sell, double alpha, double *x, double beta, double *y);
+
 #ifdef __cplusplus
 }
 #endif
+
+/* Type-generic front end, selecting the double or single precision worker routine by the types of the arguments:
+ *   mylib_add(tcontrol, v1, v2, vresult, vsize):    mylib_vector_add() for double, mylib_vector_add_float() for float vectors
+ *   mylib_dot(tcontrol, v1, v2, dotresult, vsize):  mylib_vector_dot() for double, mylib_vector_dot_float() for float vectors and a float result,
+ *                                                   mylib_vector_dsdot() for float vectors and a double result
+ * Implemented with _Generic in C11 and with overloads in C++. */
+#ifdef __cplusplus
+
+inline int mylib_add(mylib_ThreadControl tcontrol, double *v1, double *v2, double *vresult, int vsize) { return mylib_vector_add(tcontrol, v1, v2, vresult, vsize); }
+inline int mylib_add(mylib_ThreadControl tcontrol, float *v1, float *v2, float *vresult, int vsize)    { return mylib_vector_add_float(tcontrol, v1, v2, vresult, vsize); }
+
+inline int mylib_dot(mylib_ThreadControl tcontrol, double *v1, double *v2, double *dotresult, int vsize) { return mylib_vector_dot(tcontrol, v1, v2, dotresult, vsize); }
+inline int mylib_dot(mylib_ThreadControl tcontrol, float *v1, float *v2, float *dotresult, int vsize)    { return mylib_vector_dot_float(tcontrol, v1, v2, dotresult, vsize); }
+inline int mylib_dot(mylib_ThreadControl tcontrol, float *v1, float *v2, double *dotresult, int vsize)   { return mylib_vector_dsdot(tcontrol, v1, v2, dotresult, vsize); }
+
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+
+#define mylib_add(tcontrol, v1, v2, vresult, vsize) \
+  _Generic((v1), double *: mylib_vector_add, float *: mylib_vector_add_float)(tcontrol, v1, v2, vresult, vsize)
+
+#define mylib_dot(tcontrol, v1, v2, dotresult, vsize) \
+  _Generic((dotresult), float *: mylib_vector_dot_float, \
+                        double *: _Generic((v1), double *: mylib_vector_dot, float *: mylib_vector_dsdot))(tcontrol, v1, v2, dotresult, vsize)
+
+#endif
+
+#endif
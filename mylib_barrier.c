@@ -0,0 +1,630 @@
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <time.h>
+#include <sched.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include "mylib_internal.h"
+
+
+/************** Common barrier interface ****************/
+
+/* Every built-in barrier starts with this header, so that a single sync callback can serve all of them.
+ * Barriers supporting split-phase synchronization provide arrive() and complete(), the others leave them NULL. */
+typedef struct mylib_Barrier_s
+{
+  void (*wait)(struct mylib_Barrier_s *barrier, int tid);
+  int  (*arrive)(struct mylib_Barrier_s *barrier, int tid);
+  void (*complete)(struct mylib_Barrier_s *barrier, int tid, int token);
+  void (*destroy)(struct mylib_Barrier_s *barrier);
+  void (*stats)(struct mylib_Barrier_s *barrier, long *spin_waits, long *parked_waits);
+  int num_threads;
+  int kind;             /* MYLIB_BARRIER_* */
+} mylib_Barrier;
+
+
+/* Sync callback for all built-in barriers. */
+void mylib_barrier_sync(int tid, int size, void *data)
+{
+  mylib_Barrier *barrier = (mylib_Barrier *)data;
+
+  barrier->wait(barrier, tid);
+}
+
+/* Arrive callback for all built-in barriers. Barriers without split-phase support perform a full barrier instead. */
+int mylib_barrier_arrive(int tid, int size, void *data)
+{
+  mylib_Barrier *barrier = (mylib_Barrier *)data;
+
+  if (!barrier->arrive)
+  {
+    barrier->wait(barrier, tid);
+    return 0;
+  }
+
+  return barrier->arrive(barrier, tid);
+}
+
+/* Wait callback for all built-in barriers. Returns once all threads arrived at the synchronization point identified by token. */
+void mylib_barrier_wait(int tid, int size, void *data, int token)
+{
+  mylib_Barrier *barrier = (mylib_Barrier *)data;
+
+  if (barrier->complete)
+    barrier->complete(barrier, tid, token);
+}
+
+/* Releases a built-in barrier. */
+void mylib_barrier_destroy(void *data)
+{
+  mylib_Barrier *barrier = (mylib_Barrier *)data;
+
+  barrier->destroy(barrier);
+}
+
+/* Returns the number of waits resolved while busy-waiting and the number of waits which parked the thread. */
+void mylib_barrier_stats(void *data, long *spin_waits, long *parked_waits)
+{
+  mylib_Barrier *barrier = (mylib_Barrier *)data;
+
+  barrier->stats(barrier, spin_waits, parked_waits);
+}
+
+
+/************** Parking of waiting threads ****************/
+
+/* Blocks while *addr equals value. May return spuriously. */
+static void mylib_park(atomic_int *addr, int value)
+{
+#ifdef __linux__
+  syscall(SYS_futex, (int *)addr, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+#else
+  sched_yield();
+#endif
+}
+
+/* Wakes all threads parked on addr. */
+static void mylib_unpark_all(atomic_int *addr)
+{
+#ifdef __linux__
+  syscall(SYS_futex, (int *)addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+static long mylib_now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long)ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+
+/************** Centralized sense-reversing barrier ****************/
+
+/* Per-thread state of the central barrier. Each entry occupies a full cache line. */
+typedef struct
+{
+  _Alignas(MYLIB_CACHE_LINE) int sense;
+  long spin_waits;      /* waits resolved while busy-waiting */
+  long parked_waits;    /* waits which exhausted the spin budget */
+} mylib_CentralBarrierLocal;
+
+/* All threads decrement 'count'. The last thread to arrive resets 'count' and flips 'sense', which releases the waiting threads.
+ * Each thread compares against its own local sense, so the barrier can be reused immediately without a second phase.
+ *
+ * If 'budget' is set (hybrid barrier), a waiting thread parks on 'sense' once its spin budget is exhausted.
+ * 'parked' counts the parked threads, so that the last thread only issues a wake-up system call if needed. */
+typedef struct
+{
+  mylib_Barrier base;
+
+  _Alignas(MYLIB_CACHE_LINE) atomic_int count;   /* number of threads yet to arrive in the current phase */
+  _Alignas(MYLIB_CACHE_LINE) atomic_int sense;   /* global sense, flipped once per phase */
+  _Alignas(MYLIB_CACHE_LINE) atomic_int parked;  /* number of threads currently parked */
+
+  mylib_ThreadFactory budget;                    /* provides sync_spin_count and sync_spin_ns. NULL for spinning without limit */
+  mylib_CentralBarrierLocal *local;              /* per-thread state, indexed by tid */
+} mylib_CentralBarrier;
+
+
+/* Busy-waits until the global sense equals local_sense or the spin budget is exhausted. Returns nonzero if the phase completed. */
+static int mylib_central_barrier_spin(mylib_CentralBarrier *barrier, int local_sense)
+{
+  unsigned int spins = 0;
+  long max_spins, max_ns, deadline = 0;
+
+  if (!barrier->budget)
+  {
+    while (atomic_load_explicit(&barrier->sense, memory_order_acquire) != local_sense)
+      mylib_spin_pause(&spins);
+    return 1;
+  }
+
+  max_spins = barrier->budget->sync_spin_count;
+  max_ns    = barrier->budget->sync_spin_ns;
+  if (max_ns > 0)
+    deadline = mylib_now_ns() + max_ns;
+
+  while (atomic_load_explicit(&barrier->sense, memory_order_acquire) != local_sense)
+  {
+    if ((long)spins >= max_spins)
+      return 0;
+
+    /* reading the clock is comparatively expensive, hence only check every 64 iterations */
+    if (max_ns > 0 && (spins & 63) == 63 && mylib_now_ns() > deadline)
+      return 0;
+
+    mylib_spin_pause(&spins);
+  }
+  return 1;
+}
+
+
+/* Arrival half of the central barrier. Returns the sense which completes the phase. */
+static int mylib_central_barrier_arrive(mylib_Barrier *base, int tid)
+{
+  mylib_CentralBarrier *barrier = (mylib_CentralBarrier *)base;
+  mylib_CentralBarrierLocal *local = barrier->local + tid;
+  int local_sense = !local->sense;
+
+  local->sense = local_sense;
+
+  if (atomic_fetch_sub_explicit(&barrier->count, 1, memory_order_acq_rel) == 1)
+  {
+    /* last thread to arrive: reset counter for the next phase, then release all other threads */
+    atomic_store_explicit(&barrier->count, barrier->base.num_threads, memory_order_relaxed);
+    atomic_store(&barrier->sense, local_sense);
+
+    /* sequentially consistent store/load pair: either we see the parked thread, or it sees the new sense before sleeping */
+    if (atomic_load(&barrier->parked) > 0)
+      mylib_unpark_all(&barrier->sense);
+  }
+
+  return local_sense;
+}
+
+/* Waiting half of the central barrier: returns once the global sense equals token. */
+static void mylib_central_barrier_complete(mylib_Barrier *base, int tid, int token)
+{
+  mylib_CentralBarrier *barrier = (mylib_CentralBarrier *)base;
+  mylib_CentralBarrierLocal *local = barrier->local + tid;
+
+  if (mylib_central_barrier_spin(barrier, token))
+  {
+    ++local->spin_waits;
+  }
+  else
+  {
+    atomic_fetch_add(&barrier->parked, 1);
+    while (atomic_load(&barrier->sense) != token)
+      mylib_park(&barrier->sense, !token);
+    atomic_fetch_sub(&barrier->parked, 1);
+
+    ++local->parked_waits;
+  }
+}
+
+static void mylib_central_barrier_wait(mylib_Barrier *base, int tid)
+{
+  mylib_central_barrier_complete(base, tid, mylib_central_barrier_arrive(base, tid));
+}
+
+static void mylib_central_barrier_stats(mylib_Barrier *base, long *spin_waits, long *parked_waits)
+{
+  int i;
+  mylib_CentralBarrier *barrier = (mylib_CentralBarrier *)base;
+
+  *spin_waits   = 0;
+  *parked_waits = 0;
+  for (i = 0; i < base->num_threads; ++i)
+  {
+    *spin_waits   += barrier->local[i].spin_waits;
+    *parked_waits += barrier->local[i].parked_waits;
+  }
+}
+
+static void mylib_central_barrier_destroy(mylib_Barrier *base)
+{
+  mylib_CentralBarrier *barrier = (mylib_CentralBarrier *)base;
+
+  free(barrier->local);
+  free(barrier);
+}
+
+/* Creates a centralized sense-reversing barrier. Spins without limit if budget is NULL. */
+static int mylib_central_barrier_create(int num_threads, mylib_ThreadFactory budget, void **result)
+{
+  int i;
+  mylib_CentralBarrier *barrier;
+
+  if (num_threads < 1)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  barrier = (mylib_CentralBarrier *)mylib_aligned_malloc(sizeof(mylib_CentralBarrier));
+  if (!barrier)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  barrier->local = (mylib_CentralBarrierLocal *)mylib_aligned_malloc(num_threads * sizeof(mylib_CentralBarrierLocal));
+  if (!barrier->local)
+  {
+    free(barrier);
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+
+  barrier->base.wait        = mylib_central_barrier_wait;
+  barrier->base.arrive      = mylib_central_barrier_arrive;
+  barrier->base.complete    = mylib_central_barrier_complete;
+  barrier->base.destroy     = mylib_central_barrier_destroy;
+  barrier->base.stats       = mylib_central_barrier_stats;
+  barrier->base.num_threads = num_threads;
+  barrier->budget           = budget;
+
+  atomic_init(&barrier->count, num_threads);
+  atomic_init(&barrier->sense, 0);
+  atomic_init(&barrier->parked, 0);
+  for (i = 0; i < num_threads; ++i)
+  {
+    barrier->local[i].sense        = 0;
+    barrier->local[i].spin_waits   = 0;
+    barrier->local[i].parked_waits = 0;
+  }
+
+  *result = barrier;
+  return MYLIB_SUCCESS;
+}
+
+
+/************** Dissemination barrier ****************/
+
+/* Flag written by one other thread. Each flag occupies a full cache line. */
+typedef struct
+{
+  _Alignas(MYLIB_CACHE_LINE) atomic_int value;
+} mylib_BarrierFlag;
+
+/* Per-thread state of the dissemination barrier. */
+typedef struct
+{
+  _Alignas(MYLIB_CACHE_LINE) int parity;  /* selects one of the two flag sets, alternates every phase */
+  int sense;                              /* value signalled in the current phase, flipped every other phase */
+  long spin_waits;
+} mylib_DisseminationBarrierLocal;
+
+/* Dissemination barrier (Hensgen, Finkel, Manber). In round k, thread tid signals thread (tid + 2^k) mod P and waits for thread (tid - 2^k) mod P.
+ * After ceil(log2(P)) rounds every thread has transitively heard from all others. Each thread only spins on its own flags. */
+typedef struct
+{
+  mylib_Barrier base;
+
+  int num_rounds;
+  mylib_BarrierFlag *flags;                 /* flags[(tid * 2 + parity) * num_rounds + round] */
+  mylib_DisseminationBarrierLocal *local;
+} mylib_DisseminationBarrier;
+
+
+static void mylib_dissemination_barrier_wait(mylib_Barrier *base, int tid)
+{
+  mylib_DisseminationBarrier *barrier = (mylib_DisseminationBarrier *)base;
+  mylib_DisseminationBarrierLocal *local = barrier->local + tid;
+  int k, distance;
+  int P = base->num_threads;
+  int R = barrier->num_rounds;
+
+  for (k = 0, distance = 1; k < R; ++k, distance *= 2)
+  {
+    int partner = (tid + distance) % P;
+    mylib_BarrierFlag *own_flag = barrier->flags + (tid * 2 + local->parity) * R + k;
+    unsigned int spins = 0;
+
+    atomic_store_explicit(&barrier->flags[(partner * 2 + local->parity) * R + k].value, local->sense, memory_order_release);
+    while (atomic_load_explicit(&own_flag->value, memory_order_acquire) != local->sense)
+      mylib_spin_pause(&spins);
+  }
+
+  if (local->parity == 1)
+    local->sense = !local->sense;
+  local->parity = 1 - local->parity;
+
+  ++local->spin_waits;
+}
+
+static void mylib_dissemination_barrier_stats(mylib_Barrier *base, long *spin_waits, long *parked_waits)
+{
+  int i;
+  mylib_DisseminationBarrier *barrier = (mylib_DisseminationBarrier *)base;
+
+  *spin_waits   = 0;
+  *parked_waits = 0;
+  for (i = 0; i < base->num_threads; ++i)
+    *spin_waits += barrier->local[i].spin_waits;
+}
+
+static void mylib_dissemination_barrier_destroy(mylib_Barrier *base)
+{
+  mylib_DisseminationBarrier *barrier = (mylib_DisseminationBarrier *)base;
+
+  free(barrier->flags);
+  free(barrier->local);
+  free(barrier);
+}
+
+static int mylib_dissemination_barrier_create(int num_threads, void **result)
+{
+  int i;
+  mylib_DisseminationBarrier *barrier;
+
+  if (num_threads < 1)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  barrier = (mylib_DisseminationBarrier *)malloc(sizeof(mylib_DisseminationBarrier));
+  if (!barrier)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  barrier->num_rounds = 0;
+  while ((1 << barrier->num_rounds) < num_threads)
+    ++barrier->num_rounds;
+
+  /* one extra flag, so that the allocation is non-empty for a single thread */
+  barrier->flags = (mylib_BarrierFlag *)mylib_aligned_malloc((num_threads * 2 * barrier->num_rounds + 1) * sizeof(mylib_BarrierFlag));
+  barrier->local = (mylib_DisseminationBarrierLocal *)mylib_aligned_malloc(num_threads * sizeof(mylib_DisseminationBarrierLocal));
+  if (!barrier->flags || !barrier->local)
+  {
+    free(barrier->flags);
+    free(barrier->local);
+    free(barrier);
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+
+  barrier->base.wait        = mylib_dissemination_barrier_wait;
+  barrier->base.arrive      = NULL;
+  barrier->base.complete    = NULL;
+  barrier->base.destroy     = mylib_dissemination_barrier_destroy;
+  barrier->base.stats       = mylib_dissemination_barrier_stats;
+  barrier->base.num_threads = num_threads;
+
+  for (i = 0; i < num_threads * 2 * barrier->num_rounds + 1; ++i)
+    atomic_init(&barrier->flags[i].value, 0);
+  for (i = 0; i < num_threads; ++i)
+  {
+    barrier->local[i].parity     = 0;
+    barrier->local[i].sense      = 1;
+    barrier->local[i].spin_waits = 0;
+  }
+
+  *result = barrier;
+  return MYLIB_SUCCESS;
+}
+
+
+/************** Tournament barrier ****************/
+
+/* Roles of a thread in one round of the tournament */
+#define MYLIB_TOURNAMENT_BYE       0   /* no opponent in this round, advances without waiting */
+#define MYLIB_TOURNAMENT_WINNER    1   /* waits for the loser, advances to the next round, wakes up the loser afterwards */
+#define MYLIB_TOURNAMENT_LOSER     2   /* signals the winner, then waits to be woken up */
+#define MYLIB_TOURNAMENT_CHAMPION  3   /* winner of the final round, starts the wake-up */
+
+/* State of one thread in one round. Each entry occupies a full cache line. */
+typedef struct
+{
+  _Alignas(MYLIB_CACHE_LINE) atomic_int flag;  /* written by the opponent */
+  int role;
+  atomic_int *opponent_flag;
+} mylib_TournamentRound;
+
+/* Per-thread state of the tournament barrier. */
+typedef struct
+{
+  _Alignas(MYLIB_CACHE_LINE) int sense;
+  long spin_waits;
+} mylib_TournamentBarrierLocal;
+
+/* Tournament barrier (Mellor-Crummey, Scott). Threads are paired up in a binary tournament with statically determined winners.
+ * Losers signal their winner and wait, winners advance, the champion then wakes up the losers along the same tree.
+ * Every flag is written by exactly one thread and spun on by exactly one thread, and only P-1 signals are needed per phase. */
+typedef struct
+{
+  mylib_Barrier base;
+
+  int num_rounds;
+  mylib_TournamentRound *rounds;          /* rounds[tid * (num_rounds + 1) + k], round 0 unused */
+  mylib_TournamentBarrierLocal *local;
+} mylib_TournamentBarrier;
+
+
+static void mylib_tournament_spin(atomic_int *flag, int sense)
+{
+  unsigned int spins = 0;
+
+  while (atomic_load_explicit(flag, memory_order_acquire) != sense)
+    mylib_spin_pause(&spins);
+}
+
+static void mylib_tournament_barrier_wait(mylib_Barrier *base, int tid)
+{
+  mylib_TournamentBarrier *barrier = (mylib_TournamentBarrier *)base;
+  mylib_TournamentBarrierLocal *local = barrier->local + tid;
+  mylib_TournamentRound *rounds = barrier->rounds + tid * (barrier->num_rounds + 1);
+  int sense = local->sense;
+  int k;
+
+  /* arrival: move up the tournament tree until this thread loses or becomes champion */
+  for (k = 1; k <= barrier->num_rounds; ++k)
+  {
+    if (rounds[k].role == MYLIB_TOURNAMENT_LOSER)
+    {
+      atomic_store_explicit(rounds[k].opponent_flag, sense, memory_order_release);
+      mylib_tournament_spin(&rounds[k].flag, sense);
+      break;
+    }
+
+    if (rounds[k].role == MYLIB_TOURNAMENT_WINNER)
+      mylib_tournament_spin(&rounds[k].flag, sense);
+
+    if (rounds[k].role == MYLIB_TOURNAMENT_CHAMPION)
+    {
+      mylib_tournament_spin(&rounds[k].flag, sense);
+      atomic_store_explicit(rounds[k].opponent_flag, sense, memory_order_release);
+      break;
+    }
+  }
+
+  /* wake-up: release the losers of all rounds this thread has won */
+  for (k = k - 1; k >= 1; --k)
+  {
+    if (rounds[k].role == MYLIB_TOURNAMENT_WINNER)
+      atomic_store_explicit(rounds[k].opponent_flag, sense, memory_order_release);
+  }
+
+  local->sense = !sense;
+  ++local->spin_waits;
+}
+
+static void mylib_tournament_barrier_stats(mylib_Barrier *base, long *spin_waits, long *parked_waits)
+{
+  int i;
+  mylib_TournamentBarrier *barrier = (mylib_TournamentBarrier *)base;
+
+  *spin_waits   = 0;
+  *parked_waits = 0;
+  for (i = 0; i < base->num_threads; ++i)
+    *spin_waits += barrier->local[i].spin_waits;
+}
+
+static void mylib_tournament_barrier_destroy(mylib_Barrier *base)
+{
+  mylib_TournamentBarrier *barrier = (mylib_TournamentBarrier *)base;
+
+  free(barrier->rounds);
+  free(barrier->local);
+  free(barrier);
+}
+
+static int mylib_tournament_barrier_create(int num_threads, void **result)
+{
+  int i, k;
+  int R;
+  mylib_TournamentBarrier *barrier;
+
+  if (num_threads < 1)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  barrier = (mylib_TournamentBarrier *)malloc(sizeof(mylib_TournamentBarrier));
+  if (!barrier)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  R = 0;
+  while ((1 << R) < num_threads)
+    ++R;
+  barrier->num_rounds = R;
+
+  barrier->rounds = (mylib_TournamentRound *)mylib_aligned_malloc(num_threads * (R + 1) * sizeof(mylib_TournamentRound));
+  barrier->local  = (mylib_TournamentBarrierLocal *)mylib_aligned_malloc(num_threads * sizeof(mylib_TournamentBarrierLocal));
+  if (!barrier->rounds || !barrier->local)
+  {
+    free(barrier->rounds);
+    free(barrier->local);
+    free(barrier);
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+
+  barrier->base.wait        = mylib_tournament_barrier_wait;
+  barrier->base.arrive      = NULL;
+  barrier->base.complete    = NULL;
+  barrier->base.destroy     = mylib_tournament_barrier_destroy;
+  barrier->base.stats       = mylib_tournament_barrier_stats;
+  barrier->base.num_threads = num_threads;
+
+  /* Static tournament: in round k, thread tid with tid % 2^k == 0 plays against tid + 2^(k-1) */
+  for (i = 0; i < num_threads; ++i)
+  {
+    barrier->local[i].sense      = 1;
+    barrier->local[i].spin_waits = 0;
+
+    for (k = 0; k <= R; ++k)
+    {
+      mylib_TournamentRound *round = barrier->rounds + i * (R + 1) + k;
+      int half = (k > 0) ? (1 << (k - 1)) : 0;
+
+      atomic_init(&round->flag, 0);
+      round->role          = MYLIB_TOURNAMENT_BYE;
+      round->opponent_flag = NULL;
+
+      if (k == 0)
+        continue;
+
+      if (i % (2 * half) == 0)
+      {
+        if (i + half < num_threads)
+        {
+          round->role          = (k == R) ? MYLIB_TOURNAMENT_CHAMPION : MYLIB_TOURNAMENT_WINNER;
+          round->opponent_flag = &barrier->rounds[(i + half) * (R + 1) + k].flag;
+        }
+      }
+      else if (i % (2 * half) == half)
+      {
+        round->role          = MYLIB_TOURNAMENT_LOSER;
+        round->opponent_flag = &barrier->rounds[(i - half) * (R + 1) + k].flag;
+      }
+    }
+  }
+
+  *result = barrier;
+  return MYLIB_SUCCESS;
+}
+
+
+/************** Barrier creation ****************/
+
+/* Creates a built-in barrier of the given kind for num_threads threads. */
+int mylib_barrier_create(int kind, int num_threads, mylib_ThreadFactory tfactory, void **barrier)
+{
+  int err;
+
+  switch (kind)
+  {
+  case MYLIB_BARRIER_SPIN:
+    err = mylib_central_barrier_create(num_threads, NULL, barrier);
+    break;
+  case MYLIB_BARRIER_HYBRID:
+    err = mylib_central_barrier_create(num_threads, tfactory, barrier);
+    break;
+  case MYLIB_BARRIER_DISSEMINATION:
+    err = mylib_dissemination_barrier_create(num_threads, barrier);
+    break;
+  case MYLIB_BARRIER_TOURNAMENT:
+    err = mylib_tournament_barrier_create(num_threads, barrier);
+    break;
+  default:
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+  }
+
+  if (!err)
+    ((mylib_Barrier *)*barrier)->kind = kind;
+  return err;
+}
+
+/* Returns the kind of a built-in barrier. */
+int mylib_barrier_kind(void *data)
+{
+  return ((mylib_Barrier *)data)->kind;
+}
+
+/* Picks a built-in barrier for a team of num_threads threads. */
+int mylib_barrier_select(int num_threads)
+{
+  /* For small teams a single counter is cheapest. Beyond that, all threads hammering the same cache line dominates,
+   * so switch to the log(P) barriers. The tournament needs only P-1 signals per phase instead of P*log(P), which pays off for very large teams. */
+  if (num_threads <= MYLIB_BARRIER_CENTRAL_MAX_THREADS)
+    return MYLIB_BARRIER_SPIN;
+  if (num_threads <= MYLIB_BARRIER_DISSEMINATION_MAX_THREADS)
+    return MYLIB_BARRIER_DISSEMINATION;
+  return MYLIB_BARRIER_TOURNAMENT;
+}
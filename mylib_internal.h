@@ -0,0 +1,234 @@
+#ifndef MYLIB_INTERNAL_H
+#define MYLIB_INTERNAL_H
+
+/* Declarations shared by the translation units of mylib. Not part of the public interface. */
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "mylib.h"
+
+/* Size of a cache line. Data written by different threads is kept at least this far apart to avoid false sharing. */
+#define MYLIB_CACHE_LINE 64
+
+/* Tells the compiler that ptr is aligned to a cache line, which allows aligned vector loads and stores */
+#if defined(__GNUC__)
+#define MYLIB_ASSUME_ALIGNED(ptr)  __builtin_assume_aligned((ptr), MYLIB_CACHE_LINE)
+#else
+#define MYLIB_ASSUME_ALIGNED(ptr)  (ptr)
+#endif
+
+/* Hint to the CPU that we are busy-waiting (reduces power and frees pipeline resources for a sibling hyperthread). */
+static inline void mylib_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+/* Called once per iteration of a busy-wait loop. Yields the core every now and then so that oversubscribed teams still make progress. */
+void mylib_spin_pause(unsigned int *iteration);
+
+/* Allocates size bytes aligned to a cache line. Memory is released with free(). */
+void *mylib_aligned_malloc(size_t size);
+
+
+/************** Built-in barriers (mylib_barrier.c) ****************/
+
+/* Sync callback for all built-in barriers. data is the barrier object created by mylib_barrier_create(). */
+void mylib_barrier_sync(int tid, int size, void *data);
+
+/* Arrive and wait callbacks for all built-in barriers. Barriers without split-phase support perform a full barrier in mylib_barrier_arrive(). */
+int  mylib_barrier_arrive(int tid, int size, void *data);
+void mylib_barrier_wait(int tid, int size, void *data, int token);
+
+/* Releases a built-in barrier. Registered as sync_data_destroy. */
+void mylib_barrier_destroy(void *data);
+
+/* Returns the number of waits resolved while busy-waiting and the number of waits which parked the thread. */
+void mylib_barrier_stats(void *data, long *spin_waits, long *parked_waits);
+
+/* Kinds of built-in barriers */
+#define MYLIB_BARRIER_SPIN           1   /* centralized sense-reversing barrier, busy-waits until all threads arrived */
+#define MYLIB_BARRIER_HYBRID         2   /* centralized sense-reversing barrier, busy-waits within the spin budget of the factory, then parks */
+#define MYLIB_BARRIER_DISSEMINATION  3   /* log(P) rounds of pairwise signals, each thread spins on its own flags */
+#define MYLIB_BARRIER_TOURNAMENT     4   /* static binary tournament with tree wake-up, each thread spins on its own flags */
+
+/* Team sizes up to which mylib_barrier_select() picks the central barrier and the dissemination barrier, respectively */
+#define MYLIB_BARRIER_CENTRAL_MAX_THREADS        8
+#define MYLIB_BARRIER_DISSEMINATION_MAX_THREADS  64
+
+/* Creates a built-in barrier of the given kind for num_threads threads. tfactory provides the spin budget of hybrid barriers. */
+int mylib_barrier_create(int kind, int num_threads, mylib_ThreadFactory tfactory, void **barrier);
+
+/* Returns the kind of a built-in barrier. */
+int mylib_barrier_kind(void *data);
+
+/* Picks the kind of built-in barrier best suited for a team of num_threads threads. */
+int mylib_barrier_select(int num_threads);
+
+
+/************** Work stealing (mylib_steal.c) ****************/
+
+typedef struct mylib_Steal_s *mylib_Steal;
+
+/* Creates the work-stealing deques for teams of up to capacity threads. */
+int mylib_steal_create(int capacity, mylib_Steal *steal);
+
+/* Releases the work-stealing state. NULL is ignored. */
+void mylib_steal_destroy(mylib_Steal steal);
+
+/* Resets all deques and counters. Must not be called while any thread is inside a parallel loop. */
+void mylib_steal_reset(mylib_Steal steal);
+
+
+/************** Team collectives (mylib_team.c) ****************/
+
+typedef struct mylib_Team_s *mylib_Team;
+
+/* Creates the collective state for teams of up to capacity threads. */
+int mylib_team_create(int capacity, mylib_Team *team);
+
+/* Releases the collective state of a team. NULL is ignored. */
+void mylib_team_destroy(mylib_Team team);
+
+/* Returns the collective state for the team of tcontrol, (re)creating it collectively if needed. */
+int mylib_team_get(mylib_ThreadControl tcontrol, mylib_Team *team);
+
+/* Returns the work-stealing state for the team of tcontrol, (re)creating it collectively if needed. */
+int mylib_team_get_steal(mylib_ThreadControl tcontrol, mylib_Steal *steal);
+
+/* Internal reduction operation on (value, index) pairs: maximum value, smallest index among equal values. */
+#define MYLIB_OP_MAXLOC  100
+
+/* Reduction over all threads in tcontrol, first half of an allreduce. Thread 0 returns with the result while the team is still waiting,
+ * so that it can store derived results to shared memory. It must then call mylib_team_release(). The other threads return with the released result.
+ * index is only combined for MYLIB_OP_MAXLOC, result_index may be NULL. */
+int mylib_team_reduce(mylib_ThreadControl tcontrol, double value, int index, int op, double *result, int *result_index);
+
+/* Reduces the arrays of count values of all threads in tcontrol element-wise with op (MYLIB_OP_SUM, MYLIB_OP_MIN, MYLIB_OP_MAX) into 'values' of thread 0,
+ * which returns while the team is still waiting and must then call mylib_team_release(). 'values' of the other threads are overwritten with partial results. */
+int mylib_team_reduce_array(mylib_ThreadControl tcontrol, double *values, int count, int op);
+
+/* Second half of an allreduce: thread 0 hands result and result_index to the threads waiting in mylib_team_reduce() or mylib_team_reduce_array(). */
+void mylib_team_release(mylib_ThreadControl tcontrol, double result, int result_index);
+
+/* Allreduce over all threads in tcontrol. If root_result is not NULL, thread 0 stores the result there before any thread returns. */
+int mylib_team_allreduce_double(mylib_ThreadControl tcontrol, double value, int op, double *result, double *root_result);
+
+
+/************** Persistent worker pool (mylib_pool.c) ****************/
+
+typedef struct mylib_Pool_s *mylib_Pool;
+
+/* Creates num_threads-1 worker threads for tfactory and registers the pool in tfactory->pool. The factory's sync routine must be set up for num_threads threads. */
+int mylib_pool_create(mylib_ThreadFactory tfactory, int num_threads);
+
+/* Stops and joins all workers, then releases the pool. NULL is ignored. */
+void mylib_pool_destroy(mylib_ThreadFactory tfactory, mylib_Pool pool);
+
+/* Runs fn(tcontrol, arg) on all threads of the pool, with the calling thread as thread 0. Returns after all threads completed fn. */
+int mylib_pool_run(mylib_Pool pool, void (*fn)(mylib_ThreadControl tcontrol, void *arg), void *arg);
+
+
+/************** Arena for mylib_ThreadControl_malloc() (mylib_memory.c) ****************/
+
+typedef struct mylib_Arena_s *mylib_Arena;
+
+/* Hands out num_bytes bytes at the arena position of tcontrol. Grows the arena collectively if needed. */
+int mylib_arena_alloc(mylib_ThreadControl tcontrol, size_t num_bytes, void **ptr);
+
+/* Moves the arena position of tcontrol back to ptr, which must have been obtained from mylib_arena_alloc(). */
+int mylib_arena_release(mylib_ThreadControl tcontrol, void *ptr);
+
+/* Releases all blocks of the arena. NULL is ignored. */
+void mylib_arena_destroy(mylib_Arena arena);
+
+
+/************** Teams of a factory ****************/
+
+/* Entry of the team table of a ThreadFactory. Teams share nothing, so they can run mylib operations concurrently. */
+struct mylib_TeamEntry_s
+{
+  mylib_Team team;                          /* state of the collectives, created on first use */
+  mylib_Arena arena;                        /* memory handed out by mylib_ThreadControl_malloc() */
+  void *sync_data;                          /* passed to the sync routines. Unused for team 0, which uses the sync_data of the factory */
+  void (*sync_data_destroy)(void *data);    /* releases sync_data created by mylib_ThreadFactory_create_team() */
+
+  /* thread control objects of mylib_ThreadFactory_get_control(), indexed by tid. Guarded by controls_lock */
+  mylib_ThreadControl *controls;
+  int num_controls;
+  atomic_flag controls_lock;
+};
+
+/* Returns the data to be passed to the sync routines for the team of tcontrol. */
+static inline void *mylib_sync_data(mylib_ThreadControl tcontrol)
+{
+  return tcontrol->team ? tcontrol->shared_context->teams[tcontrol->team].sync_data : tcontrol->shared_context->sync_data;
+}
+
+
+/************** Vector kernels (mylib_kernels.c) ****************/
+
+/* Instruction sets with hand-vectorized kernels */
+#define MYLIB_ISA_SCALAR  0
+#define MYLIB_ISA_AVX2    1   /* AVX2 and FMA */
+#define MYLIB_ISA_AVX512  2   /* AVX-512F */
+
+/* Single-threaded kernels of the worker routines for one instruction set. Take an aligned fast path if all pointers are aligned to a cache line. */
+typedef struct
+{
+  const char *name;
+  void   (*add)(const double *v1, const double *v2, double *vresult, int n);   /* vresult[i] = v1[i] + v2[i] */
+  void   (*add_stream)(const double *v1, const double *v2, double *vresult, int n);   /* same, with non-temporal stores to vresult */
+  double (*dot)(const double *v1, const double *v2, int n);                    /* sum of v1[i] * v2[i] */
+  void   (*axpy)(double alpha, const double *x, double *y, int n);            /* y[i] += alpha * x[i] */
+  void   (*scal)(double alpha, double *x, int n);                              /* x[i] *= alpha */
+  void   (*swap)(double *x, double *y, int n);                                 /* exchanges x[i] and y[i] */
+  double (*asum)(const double *x, int n);                                      /* sum of |x[i]| */
+  double (*amax)(const double *x, int n);                                      /* maximum of |x[i]|, 0 if n is 0 */
+  double (*axpy_dot)(double alpha, const double *x, double *y, const double *z, int n);   /* axpy, returns the sum of y[i] * z[i] with the updated y. z may be y */
+  double (*add_dot)(const double *v1, const double *v2, double *vresult, const double *v3, int n);   /* add, returns the sum of vresult[i] * v3[i]. v3 may be vresult */
+  void   (*mdot)(const double *x, const double *const *y, int k, int offset, int n, double *results);   /* results[j] += sum of x[i] * y[j][offset + i], j < k */
+  void   (*maxpy)(const double *alpha, const double *const *x, int k, int offset, int n, double *y);    /* y[i] += sum of alpha[j] * x[j][offset + i], j < k */
+  int gemm_mr;                                                                 /* rows of the tile of C updated by gemm */
+  int gemm_nr;                                                                 /* columns of the tile of C updated by gemm */
+  void   (*gemm)(int kc, const double *a, const double *b, double *c, int ldc);   /* c[i * ldc + j] += sum of a[p * gemm_mr + i] * b[p * gemm_nr + j], p < kc */
+  void   (*sell)(int c, int width, const double *values, const int *cols, const double *x, double *results);   /* results[r] = sum of values[j * c + r] * x[cols[j * c + r]], r < c, j < width, skipping negative cols */
+  void   (*add_float)(const float *v1, const float *v2, float *vresult, int n);          /* single precision add */
+  void   (*add_stream_float)(const float *v1, const float *v2, float *vresult, int n);   /* single precision add with non-temporal stores */
+  float  (*dot_float)(const float *v1, const float *v2, int n);                         /* single precision dot, accumulated in single precision */
+  double (*dsdot)(const float *v1, const float *v2, int n);                             /* single precision dot, accumulated in double precision */
+} mylib_Kernels;
+
+/* Returns the fastest kernels supported by the CPU. Detection via cpuid runs on the first call. */
+const mylib_Kernels *mylib_kernels(void);
+
+/* Returns the kernels for the given instruction set (MYLIB_ISA_*), or NULL if the CPU does not support it. */
+const mylib_Kernels *mylib_kernels_select(int isa);
+
+
+/************** Topology (mylib_topology.c) ****************/
+
+/* Returns the NUMA node of the given OS cpu number, 0 if unknown. */
+int mylib_topology_node_of_cpu(int cpu);
+
+/* Returns the aggregate size in bytes of the last-level caches available to the process (one per package), 0 if unknown. */
+long mylib_topology_cache_bytes(void);
+
+
+/************** Work distribution ****************/
+
+/* Blocks of the static partition are a multiple of this number of elements, i.e. of a cache line of doubles */
+#define MYLIB_PARTITION_ALIGN  ((int)(MYLIB_CACHE_LINE / sizeof(double)))
+
+/* Computes the index range [*begin, *end) of the calling thread when splitting size elements equally over the threads in tcontrol. */
+void mylib_partition(mylib_ThreadControl tcontrol, int size, int *begin, int *end);
+
+/* Applies chunk(tcontrol, begin, end, args) to ranges covering [0, size) according to the 'schedule' of the ThreadFactory. Used by all worker routines. */
+int mylib_apply(mylib_ThreadControl tcontrol, int size,
+                void (*chunk)(mylib_ThreadControl tcontrol, int begin, int end, void *arg), void *args);
+
+#endif
@@ -0,0 +1,1464 @@
+
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MYLIB_HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#include "mylib_internal.h"
+
+
+/************** Scalar kernels ****************/
+
+/* Returns nonzero if all pointers are aligned to a cache line. NULL counts as aligned. */
+static int mylib_is_aligned(const void *p1, const void *p2, const void *p3)
+{
+  return (((uintptr_t)p1 | (uintptr_t)p2 | (uintptr_t)p3) & (MYLIB_CACHE_LINE - 1)) == 0;
+}
+
+/* vresult[i] = v1[i] + v2[i] for i < n */
+static void mylib_add_scalar(const double *v1, const double *v2, double *vresult, int n)
+{
+  int i;
+
+  if (mylib_is_aligned(v1, v2, vresult))
+  {
+    /* Aligned fast path, e.g. for vectors from mylib_vector_alloc() */
+    const double *a1 = (const double *)MYLIB_ASSUME_ALIGNED(v1);
+    const double *a2 = (const double *)MYLIB_ASSUME_ALIGNED(v2);
+    double *ar       = (double *)MYLIB_ASSUME_ALIGNED(vresult);
+
+    for (i = 0; i < n; ++i)
+      ar[i] = a1[i] + a2[i];
+  }
+  else
+  {
+    for (i = 0; i < n; ++i)
+      vresult[i] = v1[i] + v2[i];
+  }
+}
+
+/* Returns the sum of v1[i] * v2[i] for i < n */
+static double mylib_dot_scalar(const double *v1, const double *v2, int n)
+{
+  double result = 0;
+  int i;
+
+  if (mylib_is_aligned(v1, v2, NULL))
+  {
+    /* Aligned fast path, e.g. for vectors from mylib_vector_alloc() */
+    const double *a1 = (const double *)MYLIB_ASSUME_ALIGNED(v1);
+    const double *a2 = (const double *)MYLIB_ASSUME_ALIGNED(v2);
+
+    for (i = 0; i < n; ++i)
+      result += a1[i] * a2[i];
+  }
+  else
+  {
+    for (i = 0; i < n; ++i)
+      result += v1[i] * v2[i];
+  }
+
+  return result;
+}
+
+/* y[i] += alpha * x[i] for i < n */
+static void mylib_axpy_scalar(double alpha, const double *x, double *y, int n)
+{
+  int i;
+
+  if (mylib_is_aligned(x, y, NULL))
+  {
+    const double *ax = (const double *)MYLIB_ASSUME_ALIGNED(x);
+    double *ay       = (double *)MYLIB_ASSUME_ALIGNED(y);
+
+    for (i = 0; i < n; ++i)
+      ay[i] += alpha * ax[i];
+  }
+  else
+  {
+    for (i = 0; i < n; ++i)
+      y[i] += alpha * x[i];
+  }
+}
+
+/* x[i] *= alpha for i < n */
+static void mylib_scal_scalar(double alpha, double *x, int n)
+{
+  int i;
+
+  if (mylib_is_aligned(x, NULL, NULL))
+  {
+    double *ax = (double *)MYLIB_ASSUME_ALIGNED(x);
+
+    for (i = 0; i < n; ++i)
+      ax[i] *= alpha;
+  }
+  else
+  {
+    for (i = 0; i < n; ++i)
+      x[i] *= alpha;
+  }
+}
+
+/* Exchanges x[i] and y[i] for i < n */
+static void mylib_swap_scalar(double *x, double *y, int n)
+{
+  int i;
+
+  for (i = 0; i < n; ++i)
+  {
+    double tmp = x[i];
+    x[i] = y[i];
+    y[i] = tmp;
+  }
+}
+
+/* Returns the sum of |x[i]| for i < n */
+static double mylib_asum_scalar(const double *x, int n)
+{
+  double result = 0;
+  int i;
+
+  for (i = 0; i < n; ++i)
+    result += fabs(x[i]);
+
+  return result;
+}
+
+/* Returns the maximum of |x[i]| for i < n, 0 if n is 0 */
+static double mylib_amax_scalar(const double *x, int n)
+{
+  double result = 0;
+  int i;
+
+  for (i = 0; i < n; ++i)
+    if (fabs(x[i]) > result)
+      result = fabs(x[i]);
+
+  return result;
+}
+
+/* y[i] += alpha * x[i] for i < n, returns the sum of y[i] * z[i] with the updated y. z may be y. */
+static double mylib_axpy_dot_scalar(double alpha, const double *x, double *y, const double *z, int n)
+{
+  double result = 0;
+  int i;
+
+  for (i = 0; i < n; ++i)
+  {
+    y[i] += alpha * x[i];
+    result += y[i] * z[i];
+  }
+
+  return result;
+}
+
+/* vresult[i] = v1[i] + v2[i] for i < n, returns the sum of vresult[i] * v3[i]. v3 may be vresult. */
+static double mylib_add_dot_scalar(const double *v1, const double *v2, double *vresult, const double *v3, int n)
+{
+  double result = 0;
+  int i;
+
+  for (i = 0; i < n; ++i)
+  {
+    vresult[i] = v1[i] + v2[i];
+    result += vresult[i] * v3[i];
+  }
+
+  return result;
+}
+
+/* results[j] += sum of x[i] * y[j][offset + i] for i < n and j < k */
+static void mylib_mdot_scalar(const double *x, const double *const *y, int k, int offset, int n, double *results)
+{
+  int j;
+
+  for (j = 0; j < k; ++j)
+    results[j] += mylib_dot_scalar(x, y[j] + offset, n);
+}
+
+/* y[i] += sum of alpha[j] * x[j][offset + i] for i < n and j < k */
+static void mylib_maxpy_scalar(const double *alpha, const double *const *x, int k, int offset, int n, double *y)
+{
+  int j;
+
+  for (j = 0; j < k; ++j)
+    mylib_axpy_scalar(alpha[j], x[j] + offset, y, n);
+}
+
+/* Tile size of the scalar matrix-matrix kernel */
+#define MYLIB_GEMM_MR_SCALAR  4
+#define MYLIB_GEMM_NR_SCALAR  4
+
+/* c[i * ldc + j] += sum of a[p * MR + i] * b[p * NR + j] for p < kc, on a full MR-by-NR tile of C. a and b are packed panels. */
+static void mylib_gemm_scalar(int kc, const double *a, const double *b, double *c, int ldc)
+{
+  double acc[MYLIB_GEMM_MR_SCALAR][MYLIB_GEMM_NR_SCALAR] = {{0}};
+  int p, i, j;
+
+  for (p = 0; p < kc; ++p)
+  {
+    for (i = 0; i < MYLIB_GEMM_MR_SCALAR; ++i)
+      for (j = 0; j < MYLIB_GEMM_NR_SCALAR; ++j)
+        acc[i][j] += a[i] * b[j];
+
+    a += MYLIB_GEMM_MR_SCALAR;
+    b += MYLIB_GEMM_NR_SCALAR;
+  }
+
+  for (i = 0; i < MYLIB_GEMM_MR_SCALAR; ++i)
+    for (j = 0; j < MYLIB_GEMM_NR_SCALAR; ++j)
+      c[i * ldc + j] += acc[i][j];
+}
+
+/* results[r] = sum of values[j * c + r] * x[cols[j * c + r]] for r < c and j < width, on a column-major chunk of a SELL-C-sigma matrix.
+ * Padding entries have a negative column and are skipped, so that they do not read x. */
+static void mylib_sell_scalar(int c, int width, const double *values, const int *cols, const double *x, double *results)
+{
+  int r, j;
+
+  for (r = 0; r < c; ++r)
+    results[r] = 0;
+
+  /* Consecutive entries of a column belong to different rows, so the inner loop has independent accumulators */
+  for (j = 0; j < width; ++j)
+    for (r = 0; r < c; ++r)
+      if (cols[(size_t)j * c + r] >= 0)
+        results[r] += values[(size_t)j * c + r] * x[cols[(size_t)j * c + r]];
+}
+
+/* Single precision: vresult[i] = v1[i] + v2[i] for i < n */
+static void mylib_add_float_scalar(const float *v1, const float *v2, float *vresult, int n)
+{
+  int i;
+
+  for (i = 0; i < n; ++i)
+    vresult[i] = v1[i] + v2[i];
+}
+
+/* Single precision: returns the sum of v1[i] * v2[i] for i < n, accumulated in single precision */
+static float mylib_dot_float_scalar(const float *v1, const float *v2, int n)
+{
+  float result = 0;
+  int i;
+
+  for (i = 0; i < n; ++i)
+    result += v1[i] * v2[i];
+
+  return result;
+}
+
+/* Returns the sum of v1[i] * v2[i] for i < n of single precision vectors, accumulated in double precision */
+static double mylib_dsdot_scalar(const float *v1, const float *v2, int n)
+{
+  double result = 0;
+  int i;
+
+  for (i = 0; i < n; ++i)
+    result += (double)v1[i] * v2[i];
+
+  return result;
+}
+
+/* Without vector instructions there are no non-temporal stores, so streaming falls back to regular stores */
+static const mylib_Kernels mylib_kernels_scalar = {"scalar", mylib_add_scalar, mylib_add_scalar, mylib_dot_scalar,
+                                                   mylib_axpy_scalar, mylib_scal_scalar, mylib_swap_scalar, mylib_asum_scalar, mylib_amax_scalar,
+                                                   mylib_axpy_dot_scalar, mylib_add_dot_scalar, mylib_mdot_scalar, mylib_maxpy_scalar,
+                                                   MYLIB_GEMM_MR_SCALAR, MYLIB_GEMM_NR_SCALAR, mylib_gemm_scalar, mylib_sell_scalar,
+                                                   mylib_add_float_scalar, mylib_add_float_scalar, mylib_dot_float_scalar, mylib_dsdot_scalar};
+
+
+#ifdef MYLIB_HAVE_X86_KERNELS
+
+/************** AVX2 kernels ****************/
+
+/* The bodies are instantiated for aligned and unaligned data. 'aligned' is a compile-time constant after inlining, so the branches vanish. */
+
+#define MYLIB_AVX2  __attribute__((target("avx2,fma")))
+
+static inline __attribute__((always_inline)) MYLIB_AVX2 __m256d mylib_load_avx2(const double *p, int aligned)
+{
+  return aligned ? _mm256_load_pd(p) : _mm256_loadu_pd(p);
+}
+
+static inline __attribute__((always_inline)) MYLIB_AVX2 void mylib_add_avx2_body(const double *v1, const double *v2, double *vresult, int n, int aligned)
+{
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256d r0 = _mm256_add_pd(mylib_load_avx2(v1 + i,     aligned), mylib_load_avx2(v2 + i,     aligned));
+    __m256d r1 = _mm256_add_pd(mylib_load_avx2(v1 + i + 4, aligned), mylib_load_avx2(v2 + i + 4, aligned));
+
+    if (aligned)
+    {
+      _mm256_store_pd(vresult + i,     r0);
+      _mm256_store_pd(vresult + i + 4, r1);
+    }
+    else
+    {
+      _mm256_storeu_pd(vresult + i,     r0);
+      _mm256_storeu_pd(vresult + i + 4, r1);
+    }
+  }
+
+  for (; i < n; ++i)
+    vresult[i] = v1[i] + v2[i];
+}
+
+static MYLIB_AVX2 void mylib_add_avx2(const double *v1, const double *v2, double *vresult, int n)
+{
+  if (mylib_is_aligned(v1, v2, vresult))
+    mylib_add_avx2_body(v1, v2, vresult, n, 1);
+  else
+    mylib_add_avx2_body(v1, v2, vresult, n, 0);
+}
+
+/* Non-temporal stores bypass the caches, which saves reading vresult into the cache before it is overwritten (read for ownership) */
+static MYLIB_AVX2 void mylib_add_stream_avx2(const double *v1, const double *v2, double *vresult, int n)
+{
+  int i = 0;
+
+  /* Streaming stores need aligned addresses */
+  for (; i < n && ((uintptr_t)(vresult + i) & 31); ++i)
+    vresult[i] = v1[i] + v2[i];
+
+  for (; i + 8 <= n; i += 8)
+  {
+    _mm256_stream_pd(vresult + i,     _mm256_add_pd(_mm256_loadu_pd(v1 + i),     _mm256_loadu_pd(v2 + i)));
+    _mm256_stream_pd(vresult + i + 4, _mm256_add_pd(_mm256_loadu_pd(v1 + i + 4), _mm256_loadu_pd(v2 + i + 4)));
+  }
+
+  for (; i < n; ++i)
+    vresult[i] = v1[i] + v2[i];
+
+  /* Streaming stores are weakly ordered: make them visible before the thread signals completion to other threads */
+  _mm_sfence();
+}
+
+/* Four independent accumulators hide the latency of the fused multiply-adds */
+static inline __attribute__((always_inline)) MYLIB_AVX2 double mylib_dot_avx2_body(const double *v1, const double *v2, int n, int aligned)
+{
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  __m256d acc2 = _mm256_setzero_pd();
+  __m256d acc3 = _mm256_setzero_pd();
+  __m128d sum;
+  double result;
+  int i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    acc0 = _mm256_fmadd_pd(mylib_load_avx2(v1 + i,      aligned), mylib_load_avx2(v2 + i,      aligned), acc0);
+    acc1 = _mm256_fmadd_pd(mylib_load_avx2(v1 + i + 4,  aligned), mylib_load_avx2(v2 + i + 4,  aligned), acc1);
+    acc2 = _mm256_fmadd_pd(mylib_load_avx2(v1 + i + 8,  aligned), mylib_load_avx2(v2 + i + 8,  aligned), acc2);
+    acc3 = _mm256_fmadd_pd(mylib_load_avx2(v1 + i + 12, aligned), mylib_load_avx2(v2 + i + 12, aligned), acc3);
+  }
+  for (; i + 4 <= n; i += 4)
+    acc0 = _mm256_fmadd_pd(mylib_load_avx2(v1 + i, aligned), mylib_load_avx2(v2 + i, aligned), acc0);
+
+  acc0 = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+  sum  = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+  result = _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+
+  for (; i < n; ++i)
+    result += v1[i] * v2[i];
+
+  return result;
+}
+
+static MYLIB_AVX2 double mylib_dot_avx2(const double *v1, const double *v2, int n)
+{
+  if (mylib_is_aligned(v1, v2, NULL))
+    return mylib_dot_avx2_body(v1, v2, n, 1);
+  return mylib_dot_avx2_body(v1, v2, n, 0);
+}
+
+static inline __attribute__((always_inline)) MYLIB_AVX2 void mylib_store_avx2(double *p, __m256d r, int aligned)
+{
+  if (aligned)
+    _mm256_store_pd(p, r);
+  else
+    _mm256_storeu_pd(p, r);
+}
+
+static inline __attribute__((always_inline)) MYLIB_AVX2 void mylib_axpy_avx2_body(double alpha, const double *x, double *y, int n, int aligned)
+{
+  __m256d a = _mm256_set1_pd(alpha);
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    mylib_store_avx2(y + i,     _mm256_fmadd_pd(a, mylib_load_avx2(x + i,     aligned), mylib_load_avx2(y + i,     aligned)), aligned);
+    mylib_store_avx2(y + i + 4, _mm256_fmadd_pd(a, mylib_load_avx2(x + i + 4, aligned), mylib_load_avx2(y + i + 4, aligned)), aligned);
+  }
+
+  for (; i < n; ++i)
+    y[i] += alpha * x[i];
+}
+
+static MYLIB_AVX2 void mylib_axpy_avx2(double alpha, const double *x, double *y, int n)
+{
+  if (mylib_is_aligned(x, y, NULL))
+    mylib_axpy_avx2_body(alpha, x, y, n, 1);
+  else
+    mylib_axpy_avx2_body(alpha, x, y, n, 0);
+}
+
+static inline __attribute__((always_inline)) MYLIB_AVX2 void mylib_scal_avx2_body(double alpha, double *x, int n, int aligned)
+{
+  __m256d a = _mm256_set1_pd(alpha);
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    mylib_store_avx2(x + i,     _mm256_mul_pd(a, mylib_load_avx2(x + i,     aligned)), aligned);
+    mylib_store_avx2(x + i + 4, _mm256_mul_pd(a, mylib_load_avx2(x + i + 4, aligned)), aligned);
+  }
+
+  for (; i < n; ++i)
+    x[i] *= alpha;
+}
+
+static MYLIB_AVX2 void mylib_scal_avx2(double alpha, double *x, int n)
+{
+  if (mylib_is_aligned(x, NULL, NULL))
+    mylib_scal_avx2_body(alpha, x, n, 1);
+  else
+    mylib_scal_avx2_body(alpha, x, n, 0);
+}
+
+static MYLIB_AVX2 void mylib_swap_avx2(double *x, double *y, int n)
+{
+  int i = 0;
+
+  for (; i + 4 <= n; i += 4)
+  {
+    __m256d rx = _mm256_loadu_pd(x + i);
+
+    _mm256_storeu_pd(x + i, _mm256_loadu_pd(y + i));
+    _mm256_storeu_pd(y + i, rx);
+  }
+
+  for (; i < n; ++i)
+  {
+    double tmp = x[i];
+    x[i] = y[i];
+    y[i] = tmp;
+  }
+}
+
+/* |x| by clearing the sign bit */
+static inline __attribute__((always_inline)) MYLIB_AVX2 __m256d mylib_abs_avx2(__m256d x)
+{
+  return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x);
+}
+
+/* Horizontal sum of the four lanes */
+static inline __attribute__((always_inline)) MYLIB_AVX2 double mylib_hsum_avx2(__m256d x)
+{
+  __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(x), _mm256_extractf128_pd(x, 1));
+
+  return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+static MYLIB_AVX2 double mylib_asum_avx2(const double *x, int n)
+{
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  double result;
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    acc0 = _mm256_add_pd(acc0, mylib_abs_avx2(_mm256_loadu_pd(x + i)));
+    acc1 = _mm256_add_pd(acc1, mylib_abs_avx2(_mm256_loadu_pd(x + i + 4)));
+  }
+
+  result = mylib_hsum_avx2(_mm256_add_pd(acc0, acc1));
+  for (; i < n; ++i)
+    result += fabs(x[i]);
+
+  return result;
+}
+
+static MYLIB_AVX2 double mylib_amax_avx2(const double *x, int n)
+{
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  __m128d max;
+  double result;
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    acc0 = _mm256_max_pd(acc0, mylib_abs_avx2(_mm256_loadu_pd(x + i)));
+    acc1 = _mm256_max_pd(acc1, mylib_abs_avx2(_mm256_loadu_pd(x + i + 4)));
+  }
+
+  acc0 = _mm256_max_pd(acc0, acc1);
+  max  = _mm_max_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+  result = _mm_cvtsd_f64(_mm_max_sd(max, _mm_unpackhi_pd(max, max)));
+
+  for (; i < n; ++i)
+    if (fabs(x[i]) > result)
+      result = fabs(x[i]);
+
+  return result;
+}
+
+/* Fused kernels: the updated entries are stored first and the second operand of the dot product is loaded afterwards, so that it may alias the result */
+static inline __attribute__((always_inline)) MYLIB_AVX2 double mylib_axpy_dot_avx2_body(double alpha, const double *x, double *y, const double *z, int n, int aligned)
+{
+  __m256d a    = _mm256_set1_pd(alpha);
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  double result;
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256d r0 = _mm256_fmadd_pd(a, mylib_load_avx2(x + i,     aligned), mylib_load_avx2(y + i,     aligned));
+    __m256d r1 = _mm256_fmadd_pd(a, mylib_load_avx2(x + i + 4, aligned), mylib_load_avx2(y + i + 4, aligned));
+
+    mylib_store_avx2(y + i,     r0, aligned);
+    mylib_store_avx2(y + i + 4, r1, aligned);
+    acc0 = _mm256_fmadd_pd(r0, mylib_load_avx2(z + i,     aligned), acc0);
+    acc1 = _mm256_fmadd_pd(r1, mylib_load_avx2(z + i + 4, aligned), acc1);
+  }
+
+  result = mylib_hsum_avx2(_mm256_add_pd(acc0, acc1));
+  for (; i < n; ++i)
+  {
+    y[i] += alpha * x[i];
+    result += y[i] * z[i];
+  }
+
+  return result;
+}
+
+static MYLIB_AVX2 double mylib_axpy_dot_avx2(double alpha, const double *x, double *y, const double *z, int n)
+{
+  if (mylib_is_aligned(x, y, z))
+    return mylib_axpy_dot_avx2_body(alpha, x, y, z, n, 1);
+  return mylib_axpy_dot_avx2_body(alpha, x, y, z, n, 0);
+}
+
+static inline __attribute__((always_inline)) MYLIB_AVX2 double mylib_add_dot_avx2_body(const double *v1, const double *v2, double *vresult, const double *v3, int n, int aligned)
+{
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  double result;
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256d r0 = _mm256_add_pd(mylib_load_avx2(v1 + i,     aligned), mylib_load_avx2(v2 + i,     aligned));
+    __m256d r1 = _mm256_add_pd(mylib_load_avx2(v1 + i + 4, aligned), mylib_load_avx2(v2 + i + 4, aligned));
+
+    mylib_store_avx2(vresult + i,     r0, aligned);
+    mylib_store_avx2(vresult + i + 4, r1, aligned);
+    acc0 = _mm256_fmadd_pd(r0, mylib_load_avx2(v3 + i,     aligned), acc0);
+    acc1 = _mm256_fmadd_pd(r1, mylib_load_avx2(v3 + i + 4, aligned), acc1);
+  }
+
+  result = mylib_hsum_avx2(_mm256_add_pd(acc0, acc1));
+  for (; i < n; ++i)
+  {
+    vresult[i] = v1[i] + v2[i];
+    result += vresult[i] * v3[i];
+  }
+
+  return result;
+}
+
+static MYLIB_AVX2 double mylib_add_dot_avx2(const double *v1, const double *v2, double *vresult, const double *v3, int n)
+{
+  if (mylib_is_aligned(v1, v2, vresult) && mylib_is_aligned(v3, NULL, NULL))
+    return mylib_add_dot_avx2_body(v1, v2, vresult, v3, n, 1);
+  return mylib_add_dot_avx2_body(v1, v2, vresult, v3, n, 0);
+}
+
+/* Four vectors y[j] at a time, so that each load of x feeds four fused multiply-adds */
+static MYLIB_AVX2 void mylib_mdot_avx2(const double *x, const double *const *y, int k, int offset, int n, double *results)
+{
+  int i, j;
+
+  for (j = 0; j + 4 <= k; j += 4)
+  {
+    const double *y0 = y[j] + offset, *y1 = y[j + 1] + offset, *y2 = y[j + 2] + offset, *y3 = y[j + 3] + offset;
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd();
+    __m256d acc3 = _mm256_setzero_pd();
+    double r0, r1, r2, r3;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+      __m256d xv = _mm256_loadu_pd(x + i);
+
+      acc0 = _mm256_fmadd_pd(xv, _mm256_loadu_pd(y0 + i), acc0);
+      acc1 = _mm256_fmadd_pd(xv, _mm256_loadu_pd(y1 + i), acc1);
+      acc2 = _mm256_fmadd_pd(xv, _mm256_loadu_pd(y2 + i), acc2);
+      acc3 = _mm256_fmadd_pd(xv, _mm256_loadu_pd(y3 + i), acc3);
+    }
+
+    r0 = mylib_hsum_avx2(acc0);
+    r1 = mylib_hsum_avx2(acc1);
+    r2 = mylib_hsum_avx2(acc2);
+    r3 = mylib_hsum_avx2(acc3);
+    for (; i < n; ++i)
+    {
+      r0 += x[i] * y0[i];
+      r1 += x[i] * y1[i];
+      r2 += x[i] * y2[i];
+      r3 += x[i] * y3[i];
+    }
+
+    results[j]     += r0;
+    results[j + 1] += r1;
+    results[j + 2] += r2;
+    results[j + 3] += r3;
+  }
+
+  for (; j < k; ++j)
+    results[j] += mylib_dot_avx2(x, y[j] + offset, n);
+}
+
+/* Four vectors x[j] at a time, so that y is loaded and stored once per four vectors */
+static MYLIB_AVX2 void mylib_maxpy_avx2(const double *alpha, const double *const *x, int k, int offset, int n, double *y)
+{
+  int i, j;
+
+  for (j = 0; j + 4 <= k; j += 4)
+  {
+    const double *x0 = x[j] + offset, *x1 = x[j + 1] + offset, *x2 = x[j + 2] + offset, *x3 = x[j + 3] + offset;
+    __m256d a0 = _mm256_set1_pd(alpha[j]);
+    __m256d a1 = _mm256_set1_pd(alpha[j + 1]);
+    __m256d a2 = _mm256_set1_pd(alpha[j + 2]);
+    __m256d a3 = _mm256_set1_pd(alpha[j + 3]);
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+      __m256d r = _mm256_loadu_pd(y + i);
+
+      r = _mm256_fmadd_pd(a0, _mm256_loadu_pd(x0 + i), r);
+      r = _mm256_fmadd_pd(a1, _mm256_loadu_pd(x1 + i), r);
+      r = _mm256_fmadd_pd(a2, _mm256_loadu_pd(x2 + i), r);
+      r = _mm256_fmadd_pd(a3, _mm256_loadu_pd(x3 + i), r);
+      _mm256_storeu_pd(y + i, r);
+    }
+
+    for (; i < n; ++i)
+      y[i] += alpha[j] * x0[i] + alpha[j + 1] * x1[i] + alpha[j + 2] * x2[i] + alpha[j + 3] * x3[i];
+  }
+
+  for (; j < k; ++j)
+    mylib_axpy_avx2(alpha[j], x[j] + offset, y, n);
+}
+
+/* Tile size of the AVX2 matrix-matrix kernel: 6 rows of two vectors each keep 12 accumulators, two rows of B and a broadcast in the 16 registers */
+#define MYLIB_GEMM_MR_AVX2  6
+#define MYLIB_GEMM_NR_AVX2  8
+
+static MYLIB_AVX2 void mylib_gemm_avx2(int kc, const double *a, const double *b, double *c, int ldc)
+{
+  __m256d acc[MYLIB_GEMM_MR_AVX2][2];
+  int p, i;
+
+#pragma GCC unroll 6
+  for (i = 0; i < MYLIB_GEMM_MR_AVX2; ++i)
+  {
+    acc[i][0] = _mm256_setzero_pd();
+    acc[i][1] = _mm256_setzero_pd();
+  }
+
+  for (p = 0; p < kc; ++p)
+  {
+    __m256d b0 = _mm256_loadu_pd(b);
+    __m256d b1 = _mm256_loadu_pd(b + 4);
+
+#pragma GCC unroll 6
+    for (i = 0; i < MYLIB_GEMM_MR_AVX2; ++i)
+    {
+      __m256d ai = _mm256_broadcast_sd(a + i);
+
+      acc[i][0] = _mm256_fmadd_pd(ai, b0, acc[i][0]);
+      acc[i][1] = _mm256_fmadd_pd(ai, b1, acc[i][1]);
+    }
+
+    a += MYLIB_GEMM_MR_AVX2;
+    b += MYLIB_GEMM_NR_AVX2;
+  }
+
+#pragma GCC unroll 6
+  for (i = 0; i < MYLIB_GEMM_MR_AVX2; ++i)
+  {
+    _mm256_storeu_pd(c + i * ldc,     _mm256_add_pd(_mm256_loadu_pd(c + i * ldc),     acc[i][0]));
+    _mm256_storeu_pd(c + i * ldc + 4, _mm256_add_pd(_mm256_loadu_pd(c + i * ldc + 4), acc[i][1]));
+  }
+}
+
+/* SELL-C-sigma chunk: four rows per vector, the entries of x are gathered by the column indices. Rows beyond the last multiple of four are scalar.
+ * Padding entries (negative columns) are masked out of the gather and contribute 0 * 0. */
+static MYLIB_AVX2 void mylib_sell_avx2(int c, int width, const double *values, const int *cols, const double *x, double *results)
+{
+  int r, j;
+
+  for (r = 0; r + 4 <= c; r += 4)
+  {
+    __m256d acc = _mm256_setzero_pd();
+
+    for (j = 0; j < width; ++j)
+    {
+      __m128i idx  = _mm_loadu_si128((const __m128i *)(cols + (size_t)j * c + r));
+      __m256d mask = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpgt_epi32(idx, _mm_set1_epi32(-1))));
+      __m256d xv   = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), x, idx, mask, 8);
+
+      acc = _mm256_fmadd_pd(_mm256_loadu_pd(values + (size_t)j * c + r), xv, acc);
+    }
+    _mm256_storeu_pd(results + r, acc);
+  }
+
+  for (; r < c; ++r)
+  {
+    double sum = 0;
+
+    for (j = 0; j < width; ++j)
+      if (cols[(size_t)j * c + r] >= 0)
+        sum += values[(size_t)j * c + r] * x[cols[(size_t)j * c + r]];
+    results[r] = sum;
+  }
+}
+
+/* Single precision kernels: eight floats per vector */
+static MYLIB_AVX2 void mylib_add_float_avx2(const float *v1, const float *v2, float *vresult, int n)
+{
+  int i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    _mm256_storeu_ps(vresult + i,     _mm256_add_ps(_mm256_loadu_ps(v1 + i),     _mm256_loadu_ps(v2 + i)));
+    _mm256_storeu_ps(vresult + i + 8, _mm256_add_ps(_mm256_loadu_ps(v1 + i + 8), _mm256_loadu_ps(v2 + i + 8)));
+  }
+
+  for (; i < n; ++i)
+    vresult[i] = v1[i] + v2[i];
+}
+
+static MYLIB_AVX2 void mylib_add_stream_float_avx2(const float *v1, const float *v2, float *vresult, int n)
+{
+  int i = 0;
+
+  /* Streaming stores need aligned addresses */
+  for (; i < n && ((uintptr_t)(vresult + i) & 31); ++i)
+    vresult[i] = v1[i] + v2[i];
+
+  for (; i + 16 <= n; i += 16)
+  {
+    _mm256_stream_ps(vresult + i,     _mm256_add_ps(_mm256_loadu_ps(v1 + i),     _mm256_loadu_ps(v2 + i)));
+    _mm256_stream_ps(vresult + i + 8, _mm256_add_ps(_mm256_loadu_ps(v1 + i + 8), _mm256_loadu_ps(v2 + i + 8)));
+  }
+
+  for (; i < n; ++i)
+    vresult[i] = v1[i] + v2[i];
+
+  _mm_sfence();
+}
+
+static MYLIB_AVX2 float mylib_dot_float_avx2(const float *v1, const float *v2, int n)
+{
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  __m256 acc2 = _mm256_setzero_ps();
+  __m256 acc3 = _mm256_setzero_ps();
+  __m128 sum;
+  float result;
+  int i = 0;
+
+  for (; i + 32 <= n; i += 32)
+  {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(v1 + i),      _mm256_loadu_ps(v2 + i),      acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(v1 + i + 8),  _mm256_loadu_ps(v2 + i + 8),  acc1);
+    acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(v1 + i + 16), _mm256_loadu_ps(v2 + i + 16), acc2);
+    acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(v1 + i + 24), _mm256_loadu_ps(v2 + i + 24), acc3);
+  }
+  for (; i + 8 <= n; i += 8)
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(v1 + i), _mm256_loadu_ps(v2 + i), acc0);
+
+  acc0 = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+  sum  = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+  sum  = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  result = _mm_cvtss_f32(_mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1)));
+
+  for (; i < n; ++i)
+    result += v1[i] * v2[i];
+
+  return result;
+}
+
+/* Each group of four floats is widened to doubles before the multiply, so the products and the sum are exact up to double rounding */
+static MYLIB_AVX2 double mylib_dsdot_avx2(const float *v1, const float *v2, int n)
+{
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  __m256d acc2 = _mm256_setzero_pd();
+  __m256d acc3 = _mm256_setzero_pd();
+  double result;
+  int i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    acc0 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(v1 + i)),      _mm256_cvtps_pd(_mm_loadu_ps(v2 + i)),      acc0);
+    acc1 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(v1 + i + 4)),  _mm256_cvtps_pd(_mm_loadu_ps(v2 + i + 4)),  acc1);
+    acc2 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(v1 + i + 8)),  _mm256_cvtps_pd(_mm_loadu_ps(v2 + i + 8)),  acc2);
+    acc3 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(v1 + i + 12)), _mm256_cvtps_pd(_mm_loadu_ps(v2 + i + 12)), acc3);
+  }
+  for (; i + 4 <= n; i += 4)
+    acc0 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(v1 + i)), _mm256_cvtps_pd(_mm_loadu_ps(v2 + i)), acc0);
+
+  result = mylib_hsum_avx2(_mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3)));
+  for (; i < n; ++i)
+    result += (double)v1[i] * v2[i];
+
+  return result;
+}
+
+static const mylib_Kernels mylib_kernels_avx2 = {"avx2", mylib_add_avx2, mylib_add_stream_avx2, mylib_dot_avx2,
+                                                 mylib_axpy_avx2, mylib_scal_avx2, mylib_swap_avx2, mylib_asum_avx2, mylib_amax_avx2,
+                                                 mylib_axpy_dot_avx2, mylib_add_dot_avx2, mylib_mdot_avx2, mylib_maxpy_avx2,
+                                                 MYLIB_GEMM_MR_AVX2, MYLIB_GEMM_NR_AVX2, mylib_gemm_avx2, mylib_sell_avx2,
+                                                 mylib_add_float_avx2, mylib_add_stream_float_avx2, mylib_dot_float_avx2, mylib_dsdot_avx2};
+
+
+/************** AVX-512 kernels ****************/
+
+#define MYLIB_AVX512  __attribute__((target("avx512f")))
+
+static inline __attribute__((always_inline)) MYLIB_AVX512 __m512d mylib_load_avx512(const double *p, int aligned)
+{
+  return aligned ? _mm512_load_pd(p) : _mm512_loadu_pd(p);
+}
+
+/* Mask for the remaining n < 8 elements */
+static inline __attribute__((always_inline)) MYLIB_AVX512 __mmask8 mylib_tail_mask(int n)
+{
+  return (__mmask8)((1u << n) - 1);
+}
+
+static inline __attribute__((always_inline)) MYLIB_AVX512 void mylib_add_avx512_body(const double *v1, const double *v2, double *vresult, int n, int aligned)
+{
+  __mmask8 mask;
+  int i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    __m512d r0 = _mm512_add_pd(mylib_load_avx512(v1 + i,     aligned), mylib_load_avx512(v2 + i,     aligned));
+    __m512d r1 = _mm512_add_pd(mylib_load_avx512(v1 + i + 8, aligned), mylib_load_avx512(v2 + i + 8, aligned));
+
+    if (aligned)
+    {
+      _mm512_store_pd(vresult + i,     r0);
+      _mm512_store_pd(vresult + i + 8, r1);
+    }
+    else
+    {
+      _mm512_storeu_pd(vresult + i,     r0);
+      _mm512_storeu_pd(vresult + i + 8, r1);
+    }
+  }
+  for (; i + 8 <= n; i += 8)
+    _mm512_storeu_pd(vresult + i, _mm512_add_pd(_mm512_loadu_pd(v1 + i), _mm512_loadu_pd(v2 + i)));
+
+  /* Masked loads and stores do not touch memory outside the mask, so the tail needs no scalar loop */
+  if (i < n)
+  {
+    mask = mylib_tail_mask(n - i);
+    _mm512_mask_storeu_pd(vresult + i, mask, _mm512_add_pd(_mm512_maskz_loadu_pd(mask, v1 + i), _mm512_maskz_loadu_pd(mask, v2 + i)));
+  }
+}
+
+static MYLIB_AVX512 void mylib_add_avx512(const double *v1, const double *v2, double *vresult, int n)
+{
+  if (mylib_is_aligned(v1, v2, vresult))
+    mylib_add_avx512_body(v1, v2, vresult, n, 1);
+  else
+    mylib_add_avx512_body(v1, v2, vresult, n, 0);
+}
+
+static MYLIB_AVX512 void mylib_add_stream_avx512(const double *v1, const double *v2, double *vresult, int n)
+{
+  __mmask8 mask;
+  int i = 0;
+
+  /* Streaming stores need aligned addresses: handle the first partial cache line with a masked store */
+  if (((uintptr_t)vresult & 7) == 0 && ((uintptr_t)vresult & 63))
+  {
+    i = (int)((64 - ((uintptr_t)vresult & 63)) / sizeof(double));
+    if (i > n)
+      i = n;
+    mask = mylib_tail_mask(i);
+    _mm512_mask_storeu_pd(vresult, mask, _mm512_add_pd(_mm512_maskz_loadu_pd(mask, v1), _mm512_maskz_loadu_pd(mask, v2)));
+  }
+
+  if (((uintptr_t)(vresult + i) & 63) == 0)
+  {
+    for (; i + 16 <= n; i += 16)
+    {
+      _mm512_stream_pd(vresult + i,     _mm512_add_pd(_mm512_loadu_pd(v1 + i),     _mm512_loadu_pd(v2 + i)));
+      _mm512_stream_pd(vresult + i + 8, _mm512_add_pd(_mm512_loadu_pd(v1 + i + 8), _mm512_loadu_pd(v2 + i + 8)));
+    }
+    for (; i + 8 <= n; i += 8)
+      _mm512_stream_pd(vresult + i, _mm512_add_pd(_mm512_loadu_pd(v1 + i), _mm512_loadu_pd(v2 + i)));
+  }
+
+  /* Remainder, or all of it if vresult is not even aligned to a double */
+  mylib_add_avx512(v1 + i, v2 + i, vresult + i, n - i);
+
+  /* Streaming stores are weakly ordered: make them visible before the thread signals completion to other threads */
+  _mm_sfence();
+}
+
+static inline __attribute__((always_inline)) MYLIB_AVX512 double mylib_dot_avx512_body(const double *v1, const double *v2, int n, int aligned)
+{
+  __m512d acc0 = _mm512_setzero_pd();
+  __m512d acc1 = _mm512_setzero_pd();
+  __m512d acc2 = _mm512_setzero_pd();
+  __m512d acc3 = _mm512_setzero_pd();
+  __mmask8 mask;
+  int i = 0;
+
+  for (; i + 32 <= n; i += 32)
+  {
+    acc0 = _mm512_fmadd_pd(mylib_load_avx512(v1 + i,      aligned), mylib_load_avx512(v2 + i,      aligned), acc0);
+    acc1 = _mm512_fmadd_pd(mylib_load_avx512(v1 + i + 8,  aligned), mylib_load_avx512(v2 + i + 8,  aligned), acc1);
+    acc2 = _mm512_fmadd_pd(mylib_load_avx512(v1 + i + 16, aligned), mylib_load_avx512(v2 + i + 16, aligned), acc2);
+    acc3 = _mm512_fmadd_pd(mylib_load_avx512(v1 + i + 24, aligned), mylib_load_avx512(v2 + i + 24, aligned), acc3);
+  }
+  for (; i + 8 <= n; i += 8)
+    acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(v1 + i), _mm512_loadu_pd(v2 + i), acc0);
+
+  if (i < n)
+  {
+    mask = mylib_tail_mask(n - i);
+    acc1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, v1 + i), _mm512_maskz_loadu_pd(mask, v2 + i), acc1);
+  }
+
+  return _mm512_reduce_add_pd(_mm512_add_pd(_mm512_add_pd(acc0, acc1), _mm512_add_pd(acc2, acc3)));
+}
+
+static MYLIB_AVX512 double mylib_dot_avx512(const double *v1, const double *v2, int n)
+{
+  if (mylib_is_aligned(v1, v2, NULL))
+    return mylib_dot_avx512_body(v1, v2, n, 1);
+  return mylib_dot_avx512_body(v1, v2, n, 0);
+}
+
+static inline __attribute__((always_inline)) MYLIB_AVX512 void mylib_store_avx512(double *p, __m512d r, int aligned)
+{
+  if (aligned)
+    _mm512_store_pd(p, r);
+  else
+    _mm512_storeu_pd(p, r);
+}
+
+static inline __attribute__((always_inline)) MYLIB_AVX512 void mylib_axpy_avx512_body(double alpha, const double *x, double *y, int n, int aligned)
+{
+  __m512d a = _mm512_set1_pd(alpha);
+  __mmask8 mask;
+  int i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    mylib_store_avx512(y + i,     _mm512_fmadd_pd(a, mylib_load_avx512(x + i,     aligned), mylib_load_avx512(y + i,     aligned)), aligned);
+    mylib_store_avx512(y + i + 8, _mm512_fmadd_pd(a, mylib_load_avx512(x + i + 8, aligned), mylib_load_avx512(y + i + 8, aligned)), aligned);
+  }
+
+  for (; i < n; i += 8)
+  {
+    mask = (n - i >= 8) ? (__mmask8)0xFF : mylib_tail_mask(n - i);
+    _mm512_mask_storeu_pd(y + i, mask, _mm512_fmadd_pd(a, _mm512_maskz_loadu_pd(mask, x + i), _mm512_maskz_loadu_pd(mask, y + i)));
+  }
+}
+
+static MYLIB_AVX512 void mylib_axpy_avx512(double alpha, const double *x, double *y, int n)
+{
+  if (mylib_is_aligned(x, y, NULL))
+    mylib_axpy_avx512_body(alpha, x, y, n, 1);
+  else
+    mylib_axpy_avx512_body(alpha, x, y, n, 0);
+}
+
+static inline __attribute__((always_inline)) MYLIB_AVX512 void mylib_scal_avx512_body(double alpha, double *x, int n, int aligned)
+{
+  __m512d a = _mm512_set1_pd(alpha);
+  __mmask8 mask;
+  int i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    mylib_store_avx512(x + i,     _mm512_mul_pd(a, mylib_load_avx512(x + i,     aligned)), aligned);
+    mylib_store_avx512(x + i + 8, _mm512_mul_pd(a, mylib_load_avx512(x + i + 8, aligned)), aligned);
+  }
+
+  for (; i < n; i += 8)
+  {
+    mask = (n - i >= 8) ? (__mmask8)0xFF : mylib_tail_mask(n - i);
+    _mm512_mask_storeu_pd(x + i, mask, _mm512_mul_pd(a, _mm512_maskz_loadu_pd(mask, x + i)));
+  }
+}
+
+static MYLIB_AVX512 void mylib_scal_avx512(double alpha, double *x, int n)
+{
+  if (mylib_is_aligned(x, NULL, NULL))
+    mylib_scal_avx512_body(alpha, x, n, 1);
+  else
+    mylib_scal_avx512_body(alpha, x, n, 0);
+}
+
+static MYLIB_AVX512 void mylib_swap_avx512(double *x, double *y, int n)
+{
+  __mmask8 mask;
+  int i;
+
+  for (i = 0; i < n; i += 8)
+  {
+    __m512d rx;
+
+    mask = (n - i >= 8) ? (__mmask8)0xFF : mylib_tail_mask(n - i);
+    rx = _mm512_maskz_loadu_pd(mask, x + i);
+    _mm512_mask_storeu_pd(x + i, mask, _mm512_maskz_loadu_pd(mask, y + i));
+    _mm512_mask_storeu_pd(y + i, mask, rx);
+  }
+}
+
+static MYLIB_AVX512 double mylib_asum_avx512(const double *x, int n)
+{
+  __m512d acc0 = _mm512_setzero_pd();
+  __m512d acc1 = _mm512_setzero_pd();
+  __mmask8 mask;
+  int i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    acc0 = _mm512_add_pd(acc0, _mm512_abs_pd(_mm512_loadu_pd(x + i)));
+    acc1 = _mm512_add_pd(acc1, _mm512_abs_pd(_mm512_loadu_pd(x + i + 8)));
+  }
+
+  for (; i < n; i += 8)
+  {
+    mask = (n - i >= 8) ? (__mmask8)0xFF : mylib_tail_mask(n - i);
+    acc0 = _mm512_add_pd(acc0, _mm512_abs_pd(_mm512_maskz_loadu_pd(mask, x + i)));
+  }
+
+  return _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1));
+}
+
+/* Masked-off lanes load as zero, which never exceeds an absolute value */
+static MYLIB_AVX512 double mylib_amax_avx512(const double *x, int n)
+{
+  __m512d acc0 = _mm512_setzero_pd();
+  __m512d acc1 = _mm512_setzero_pd();
+  __mmask8 mask;
+  int i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    acc0 = _mm512_max_pd(acc0, _mm512_abs_pd(_mm512_loadu_pd(x + i)));
+    acc1 = _mm512_max_pd(acc1, _mm512_abs_pd(_mm512_loadu_pd(x + i + 8)));
+  }
+
+  for (; i < n; i += 8)
+  {
+    mask = (n - i >= 8) ? (__mmask8)0xFF : mylib_tail_mask(n - i);
+    acc0 = _mm512_max_pd(acc0, _mm512_abs_pd(_mm512_maskz_loadu_pd(mask, x + i)));
+  }
+
+  return _mm512_reduce_max_pd(_mm512_max_pd(acc0, acc1));
+}
+
+static inline __attribute__((always_inline)) MYLIB_AVX512 double mylib_axpy_dot_avx512_body(double alpha, const double *x, double *y, const double *z, int n, int aligned)
+{
+  __m512d a    = _mm512_set1_pd(alpha);
+  __m512d acc0 = _mm512_setzero_pd();
+  __m512d acc1 = _mm512_setzero_pd();
+  __mmask8 mask;
+  int i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    __m512d r0 = _mm512_fmadd_pd(a, mylib_load_avx512(x + i,     aligned), mylib_load_avx512(y + i,     aligned));
+    __m512d r1 = _mm512_fmadd_pd(a, mylib_load_avx512(x + i + 8, aligned), mylib_load_avx512(y + i + 8, aligned));
+
+    mylib_store_avx512(y + i,     r0, aligned);
+    mylib_store_avx512(y + i + 8, r1, aligned);
+    acc0 = _mm512_fmadd_pd(r0, mylib_load_avx512(z + i,     aligned), acc0);
+    acc1 = _mm512_fmadd_pd(r1, mylib_load_avx512(z + i + 8, aligned), acc1);
+  }
+
+  for (; i < n; i += 8)
+  {
+    __m512d r;
+
+    mask = (n - i >= 8) ? (__mmask8)0xFF : mylib_tail_mask(n - i);
+    r = _mm512_fmadd_pd(a, _mm512_maskz_loadu_pd(mask, x + i), _mm512_maskz_loadu_pd(mask, y + i));
+    _mm512_mask_storeu_pd(y + i, mask, r);
+    acc0 = _mm512_fmadd_pd(r, _mm512_maskz_loadu_pd(mask, z + i), acc0);
+  }
+
+  return _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1));
+}
+
+static MYLIB_AVX512 double mylib_axpy_dot_avx512(double alpha, const double *x, double *y, const double *z, int n)
+{
+  if (mylib_is_aligned(x, y, z))
+    return mylib_axpy_dot_avx512_body(alpha, x, y, z, n, 1);
+  return mylib_axpy_dot_avx512_body(alpha, x, y, z, n, 0);
+}
+
+static inline __attribute__((always_inline)) MYLIB_AVX512 double mylib_add_dot_avx512_body(const double *v1, const double *v2, double *vresult, const double *v3, int n, int aligned)
+{
+  __m512d acc0 = _mm512_setzero_pd();
+  __m512d acc1 = _mm512_setzero_pd();
+  __mmask8 mask;
+  int i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    __m512d r0 = _mm512_add_pd(mylib_load_avx512(v1 + i,     aligned), mylib_load_avx512(v2 + i,     aligned));
+    __m512d r1 = _mm512_add_pd(mylib_load_avx512(v1 + i + 8, aligned), mylib_load_avx512(v2 + i + 8, aligned));
+
+    mylib_store_avx512(vresult + i,     r0, aligned);
+    mylib_store_avx512(vresult + i + 8, r1, aligned);
+    acc0 = _mm512_fmadd_pd(r0, mylib_load_avx512(v3 + i,     aligned), acc0);
+    acc1 = _mm512_fmadd_pd(r1, mylib_load_avx512(v3 + i + 8, aligned), acc1);
+  }
+
+  for (; i < n; i += 8)
+  {
+    __m512d r;
+
+    mask = (n - i >= 8) ? (__mmask8)0xFF : mylib_tail_mask(n - i);
+    r = _mm512_add_pd(_mm512_maskz_loadu_pd(mask, v1 + i), _mm512_maskz_loadu_pd(mask, v2 + i));
+    _mm512_mask_storeu_pd(vresult + i, mask, r);
+    acc0 = _mm512_fmadd_pd(r, _mm512_maskz_loadu_pd(mask, v3 + i), acc0);
+  }
+
+  return _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1));
+}
+
+static MYLIB_AVX512 double mylib_add_dot_avx512(const double *v1, const double *v2, double *vresult, const double *v3, int n)
+{
+  if (mylib_is_aligned(v1, v2, vresult) && mylib_is_aligned(v3, NULL, NULL))
+    return mylib_add_dot_avx512_body(v1, v2, vresult, v3, n, 1);
+  return mylib_add_dot_avx512_body(v1, v2, vresult, v3, n, 0);
+}
+
+/* Four vectors y[j] at a time, so that each load of x feeds four fused multiply-adds */
+static MYLIB_AVX512 void mylib_mdot_avx512(const double *x, const double *const *y, int k, int offset, int n, double *results)
+{
+  __mmask8 mask;
+  int i, j;
+
+  for (j = 0; j + 4 <= k; j += 4)
+  {
+    const double *y0 = y[j] + offset, *y1 = y[j + 1] + offset, *y2 = y[j + 2] + offset, *y3 = y[j + 3] + offset;
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    __m512d acc2 = _mm512_setzero_pd();
+    __m512d acc3 = _mm512_setzero_pd();
+
+    for (i = 0; i < n; i += 8)
+    {
+      __m512d xv;
+
+      mask = (n - i >= 8) ? (__mmask8)0xFF : mylib_tail_mask(n - i);
+      xv   = _mm512_maskz_loadu_pd(mask, x + i);
+      acc0 = _mm512_fmadd_pd(xv, _mm512_maskz_loadu_pd(mask, y0 + i), acc0);
+      acc1 = _mm512_fmadd_pd(xv, _mm512_maskz_loadu_pd(mask, y1 + i), acc1);
+      acc2 = _mm512_fmadd_pd(xv, _mm512_maskz_loadu_pd(mask, y2 + i), acc2);
+      acc3 = _mm512_fmadd_pd(xv, _mm512_maskz_loadu_pd(mask, y3 + i), acc3);
+    }
+
+    results[j]     += _mm512_reduce_add_pd(acc0);
+    results[j + 1] += _mm512_reduce_add_pd(acc1);
+    results[j + 2] += _mm512_reduce_add_pd(acc2);
+    results[j + 3] += _mm512_reduce_add_pd(acc3);
+  }
+
+  for (; j < k; ++j)
+    results[j] += mylib_dot_avx512(x, y[j] + offset, n);
+}
+
+/* Four vectors x[j] at a time, so that y is loaded and stored once per four vectors */
+static MYLIB_AVX512 void mylib_maxpy_avx512(const double *alpha, const double *const *x, int k, int offset, int n, double *y)
+{
+  __mmask8 mask;
+  int i, j;
+
+  for (j = 0; j + 4 <= k; j += 4)
+  {
+    const double *x0 = x[j] + offset, *x1 = x[j + 1] + offset, *x2 = x[j + 2] + offset, *x3 = x[j + 3] + offset;
+    __m512d a0 = _mm512_set1_pd(alpha[j]);
+    __m512d a1 = _mm512_set1_pd(alpha[j + 1]);
+    __m512d a2 = _mm512_set1_pd(alpha[j + 2]);
+    __m512d a3 = _mm512_set1_pd(alpha[j + 3]);
+
+    for (i = 0; i < n; i += 8)
+    {
+      __m512d r;
+
+      mask = (n - i >= 8) ? (__mmask8)0xFF : mylib_tail_mask(n - i);
+      r = _mm512_maskz_loadu_pd(mask, y + i);
+      r = _mm512_fmadd_pd(a0, _mm512_maskz_loadu_pd(mask, x0 + i), r);
+      r = _mm512_fmadd_pd(a1, _mm512_maskz_loadu_pd(mask, x1 + i), r);
+      r = _mm512_fmadd_pd(a2, _mm512_maskz_loadu_pd(mask, x2 + i), r);
+      r = _mm512_fmadd_pd(a3, _mm512_maskz_loadu_pd(mask, x3 + i), r);
+      _mm512_mask_storeu_pd(y + i, mask, r);
+    }
+  }
+
+  for (; j < k; ++j)
+    mylib_axpy_avx512(alpha[j], x[j] + offset, y, n);
+}
+
+/* Tile size of the AVX-512 matrix-matrix kernel: 8 rows of two vectors each keep 16 accumulators, leaving half of the 32 registers for B and broadcasts */
+#define MYLIB_GEMM_MR_AVX512  8
+#define MYLIB_GEMM_NR_AVX512  16
+
+static MYLIB_AVX512 void mylib_gemm_avx512(int kc, const double *a, const double *b, double *c, int ldc)
+{
+  __m512d acc[MYLIB_GEMM_MR_AVX512][2];
+  int p, i;
+
+#pragma GCC unroll 8
+  for (i = 0; i < MYLIB_GEMM_MR_AVX512; ++i)
+  {
+    acc[i][0] = _mm512_setzero_pd();
+    acc[i][1] = _mm512_setzero_pd();
+  }
+
+  for (p = 0; p < kc; ++p)
+  {
+    __m512d b0 = _mm512_loadu_pd(b);
+    __m512d b1 = _mm512_loadu_pd(b + 8);
+
+#pragma GCC unroll 8
+    for (i = 0; i < MYLIB_GEMM_MR_AVX512; ++i)
+    {
+      __m512d ai = _mm512_set1_pd(a[i]);
+
+      acc[i][0] = _mm512_fmadd_pd(ai, b0, acc[i][0]);
+      acc[i][1] = _mm512_fmadd_pd(ai, b1, acc[i][1]);
+    }
+
+    a += MYLIB_GEMM_MR_AVX512;
+    b += MYLIB_GEMM_NR_AVX512;
+  }
+
+#pragma GCC unroll 8
+  for (i = 0; i < MYLIB_GEMM_MR_AVX512; ++i)
+  {
+    _mm512_storeu_pd(c + i * ldc,     _mm512_add_pd(_mm512_loadu_pd(c + i * ldc),     acc[i][0]));
+    _mm512_storeu_pd(c + i * ldc + 8, _mm512_add_pd(_mm512_loadu_pd(c + i * ldc + 8), acc[i][1]));
+  }
+}
+
+/* SELL-C-sigma chunk: eight rows per vector, the entries of x are gathered by the column indices. The last rows use masked loads and gathers.
+ * Padding entries (negative columns) are masked out of the gather and contribute 0 * 0. */
+static MYLIB_AVX512 void mylib_sell_avx512(int c, int width, const double *values, const int *cols, const double *x, double *results)
+{
+  int r, j;
+
+  for (r = 0; r < c; r += 8)
+  {
+    __mmask8 mask = (c - r >= 8) ? 0xFF : (__mmask8)((1u << (c - r)) - 1);
+    __m512d acc = _mm512_setzero_pd();
+
+    for (j = 0; j < width; ++j)
+    {
+      __m512i cols16 = _mm512_maskz_loadu_epi32(mask, cols + (size_t)j * c + r);
+      __mmask8 valid = (__mmask8)_mm512_mask_cmpge_epi32_mask(mask, cols16, _mm512_setzero_si512());
+      __m512d xv     = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), valid, _mm512_castsi512_si256(cols16), x, 8);
+
+      acc = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, values + (size_t)j * c + r), xv, acc);
+    }
+    _mm512_mask_storeu_pd(results + r, mask, acc);
+  }
+}
+
+/* Single precision kernels: sixteen floats per vector */
+
+/* Mask for the remaining n < 16 floats */
+static inline __attribute__((always_inline)) MYLIB_AVX512 __mmask16 mylib_tail_mask16(int n)
+{
+  return (__mmask16)((1u << n) - 1);
+}
+
+static MYLIB_AVX512 void mylib_add_float_avx512(const float *v1, const float *v2, float *vresult, int n)
+{
+  __mmask16 mask;
+  int i = 0;
+
+  for (; i + 32 <= n; i += 32)
+  {
+    _mm512_storeu_ps(vresult + i,      _mm512_add_ps(_mm512_loadu_ps(v1 + i),      _mm512_loadu_ps(v2 + i)));
+    _mm512_storeu_ps(vresult + i + 16, _mm512_add_ps(_mm512_loadu_ps(v1 + i + 16), _mm512_loadu_ps(v2 + i + 16)));
+  }
+  for (; i + 16 <= n; i += 16)
+    _mm512_storeu_ps(vresult + i, _mm512_add_ps(_mm512_loadu_ps(v1 + i), _mm512_loadu_ps(v2 + i)));
+
+  if (i < n)
+  {
+    mask = mylib_tail_mask16(n - i);
+    _mm512_mask_storeu_ps(vresult + i, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, v1 + i), _mm512_maskz_loadu_ps(mask, v2 + i)));
+  }
+}
+
+static MYLIB_AVX512 void mylib_add_stream_float_avx512(const float *v1, const float *v2, float *vresult, int n)
+{
+  __mmask16 mask;
+  int i = 0;
+
+  /* Streaming stores need aligned addresses: handle the first partial cache line with a masked store */
+  if (((uintptr_t)vresult & 3) == 0 && ((uintptr_t)vresult & 63))
+  {
+    i = (int)((64 - ((uintptr_t)vresult & 63)) / sizeof(float));
+    if (i > n)
+      i = n;
+    mask = mylib_tail_mask16(i);
+    _mm512_mask_storeu_ps(vresult, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, v1), _mm512_maskz_loadu_ps(mask, v2)));
+  }
+
+  if (((uintptr_t)(vresult + i) & 63) == 0)
+  {
+    for (; i + 32 <= n; i += 32)
+    {
+      _mm512_stream_ps(vresult + i,      _mm512_add_ps(_mm512_loadu_ps(v1 + i),      _mm512_loadu_ps(v2 + i)));
+      _mm512_stream_ps(vresult + i + 16, _mm512_add_ps(_mm512_loadu_ps(v1 + i + 16), _mm512_loadu_ps(v2 + i + 16)));
+    }
+    for (; i + 16 <= n; i += 16)
+      _mm512_stream_ps(vresult + i, _mm512_add_ps(_mm512_loadu_ps(v1 + i), _mm512_loadu_ps(v2 + i)));
+  }
+
+  mylib_add_float_avx512(v1 + i, v2 + i, vresult + i, n - i);
+
+  _mm_sfence();
+}
+
+static MYLIB_AVX512 float mylib_dot_float_avx512(const float *v1, const float *v2, int n)
+{
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  __m512 acc2 = _mm512_setzero_ps();
+  __m512 acc3 = _mm512_setzero_ps();
+  __mmask16 mask;
+  int i = 0;
+
+  for (; i + 64 <= n; i += 64)
+  {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(v1 + i),      _mm512_loadu_ps(v2 + i),      acc0);
+    acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(v1 + i + 16), _mm512_loadu_ps(v2 + i + 16), acc1);
+    acc2 = _mm512_fmadd_ps(_mm512_loadu_ps(v1 + i + 32), _mm512_loadu_ps(v2 + i + 32), acc2);
+    acc3 = _mm512_fmadd_ps(_mm512_loadu_ps(v1 + i + 48), _mm512_loadu_ps(v2 + i + 48), acc3);
+  }
+  for (; i + 16 <= n; i += 16)
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(v1 + i), _mm512_loadu_ps(v2 + i), acc0);
+
+  if (i < n)
+  {
+    mask = mylib_tail_mask16(n - i);
+    acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, v1 + i), _mm512_maskz_loadu_ps(mask, v2 + i), acc1);
+  }
+
+  return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+}
+
+/* Each group of eight floats is widened to doubles before the multiply */
+static MYLIB_AVX512 double mylib_dsdot_avx512(const float *v1, const float *v2, int n)
+{
+  __m512d acc0 = _mm512_setzero_pd();
+  __m512d acc1 = _mm512_setzero_pd();
+  __m512d acc2 = _mm512_setzero_pd();
+  __m512d acc3 = _mm512_setzero_pd();
+  __mmask16 mask;
+  int i = 0;
+
+  for (; i + 32 <= n; i += 32)
+  {
+    acc0 = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm256_loadu_ps(v1 + i)),      _mm512_cvtps_pd(_mm256_loadu_ps(v2 + i)),      acc0);
+    acc1 = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm256_loadu_ps(v1 + i + 8)),  _mm512_cvtps_pd(_mm256_loadu_ps(v2 + i + 8)),  acc1);
+    acc2 = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm256_loadu_ps(v1 + i + 16)), _mm512_cvtps_pd(_mm256_loadu_ps(v2 + i + 16)), acc2);
+    acc3 = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm256_loadu_ps(v1 + i + 24)), _mm512_cvtps_pd(_mm256_loadu_ps(v2 + i + 24)), acc3);
+  }
+
+  /* Remaining groups of at most eight floats, loaded with a mask over the lower half of a vector */
+  for (; i < n; i += 8)
+  {
+    mask = mylib_tail_mask16((n - i < 8) ? n - i : 8);
+    acc0 = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm512_castps512_ps256(_mm512_maskz_loadu_ps(mask, v1 + i))),
+                           _mm512_cvtps_pd(_mm512_castps512_ps256(_mm512_maskz_loadu_ps(mask, v2 + i))), acc0);
+  }
+
+  return _mm512_reduce_add_pd(_mm512_add_pd(_mm512_add_pd(acc0, acc1), _mm512_add_pd(acc2, acc3)));
+}
+
+static const mylib_Kernels mylib_kernels_avx512 = {"avx512", mylib_add_avx512, mylib_add_stream_avx512, mylib_dot_avx512,
+                                                   mylib_axpy_avx512, mylib_scal_avx512, mylib_swap_avx512, mylib_asum_avx512, mylib_amax_avx512,
+                                                   mylib_axpy_dot_avx512, mylib_add_dot_avx512, mylib_mdot_avx512, mylib_maxpy_avx512,
+                                                   MYLIB_GEMM_MR_AVX512, MYLIB_GEMM_NR_AVX512, mylib_gemm_avx512, mylib_sell_avx512,
+                                                   mylib_add_float_avx512, mylib_add_stream_float_avx512, mylib_dot_float_avx512, mylib_dsdot_avx512};
+
+#endif
+
+
+/************** Dispatch ****************/
+
+static const mylib_Kernels *mylib_kernels_best = &mylib_kernels_scalar;
+static pthread_once_t mylib_kernels_once = PTHREAD_ONCE_INIT;
+
+/* Picks the widest instruction set supported by the CPU and the operating system (cpuid and xgetbv via the compiler's runtime). */
+static void mylib_kernels_detect(void)
+{
+  int isa;
+
+  for (isa = MYLIB_ISA_AVX512; isa > MYLIB_ISA_SCALAR; --isa)
+  {
+    const mylib_Kernels *kernels = mylib_kernels_select(isa);
+
+    if (kernels)
+    {
+      mylib_kernels_best = kernels;
+      return;
+    }
+  }
+}
+
+/* Returns the kernels for the given instruction set (MYLIB_ISA_*), or NULL if the CPU does not support it. */
+const mylib_Kernels *mylib_kernels_select(int isa)
+{
+  switch (isa)
+  {
+  case MYLIB_ISA_SCALAR:
+    return &mylib_kernels_scalar;
+#ifdef MYLIB_HAVE_X86_KERNELS
+  case MYLIB_ISA_AVX2:
+    return (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? &mylib_kernels_avx2 : NULL;
+  case MYLIB_ISA_AVX512:
+    return __builtin_cpu_supports("avx512f") ? &mylib_kernels_avx512 : NULL;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+/* Returns the fastest kernels supported by the CPU. Detection runs on the first call. */
+const mylib_Kernels *mylib_kernels(void)
+{
+  pthread_once(&mylib_kernels_once, mylib_kernels_detect);
+  return mylib_kernels_best;
+}
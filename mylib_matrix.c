@@ -0,0 +1,371 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "mylib_internal.h"
+
+
+/************** Dense matrix-vector product ****************/
+
+/* Number of rows of A processed together. Their row pointers and partial results live on the stack. */
+#define MYLIB_GEMV_ROWS  64
+
+/* Number of columns of A per block, so that the block of x (no transpose) or of the column partials (transpose) stays in the L1 cache */
+#define MYLIB_GEMV_COLS  1024
+
+/* Arguments of the chunk routines of mylib_matrix_gemv(). Each thread passes its own instance. */
+typedef struct
+{
+  double *A;
+  int lda;
+  int n;
+  double *x;
+  double *y;
+  double alpha;
+  double beta;
+  double *partial;     /* MYLIB_MATRIX_TRANS: column partials of the executing thread, n entries */
+} mylib_GemvChunkArgs;
+
+/* Chunk routine for y = alpha * A * x + beta * y: computes the entries [begin_row, end_row) of y.
+ * Blocks of x are multiplied with MYLIB_GEMV_ROWS rows while they reside in the L1 cache, the kernel takes four rows per load of x. */
+static void mylib_gemv_n_chunk(mylib_ThreadControl tcontrol, int begin_row, int end_row, void *data)
+{
+  mylib_GemvChunkArgs *args = (mylib_GemvChunkArgs *)data;
+  const mylib_Kernels *kernels = mylib_kernels();
+  const double *rows[MYLIB_GEMV_ROWS];
+  double results[MYLIB_GEMV_ROWS];
+  int row, col, i;
+
+  for (row = begin_row; row < end_row; row += MYLIB_GEMV_ROWS)
+  {
+    int num_rows = (end_row - row < MYLIB_GEMV_ROWS) ? end_row - row : MYLIB_GEMV_ROWS;
+
+    for (i = 0; i < num_rows; ++i)
+    {
+      rows[i]    = args->A + (size_t)(row + i) * args->lda;
+      results[i] = 0;
+    }
+
+    for (col = 0; col < args->n; col += MYLIB_GEMV_COLS)
+      kernels->mdot(args->x + col, rows, num_rows, col, (args->n - col < MYLIB_GEMV_COLS) ? args->n - col : MYLIB_GEMV_COLS, results);
+
+    /* As in the BLAS, y is not read if beta is zero */
+    for (i = 0; i < num_rows; ++i)
+      args->y[row + i] = (args->beta == 0) ? args->alpha * results[i] : args->alpha * results[i] + args->beta * args->y[row + i];
+  }
+}
+
+/* Chunk routine for y = alpha * A^T * x + beta * y: adds x[i] times row i of A to the column partials of the executing thread for all rows i in [begin_row, end_row).
+ * Each block of the partials stays in the L1 cache while all rows are added, the kernel adds four rows per load and store of the partials. */
+static void mylib_gemv_t_chunk(mylib_ThreadControl tcontrol, int begin_row, int end_row, void *data)
+{
+  mylib_GemvChunkArgs *args = (mylib_GemvChunkArgs *)data;
+  const mylib_Kernels *kernels = mylib_kernels();
+  const double *rows[MYLIB_GEMV_ROWS];
+  int row, col, i;
+
+  for (col = 0; col < args->n; col += MYLIB_GEMV_COLS)
+  {
+    int num_cols = (args->n - col < MYLIB_GEMV_COLS) ? args->n - col : MYLIB_GEMV_COLS;
+
+    for (row = begin_row; row < end_row; row += MYLIB_GEMV_ROWS)
+    {
+      int num_rows = (end_row - row < MYLIB_GEMV_ROWS) ? end_row - row : MYLIB_GEMV_ROWS;
+
+      for (i = 0; i < num_rows; ++i)
+        rows[i] = args->A + (size_t)(row + i) * args->lda;
+
+      kernels->maxpy(args->x + row, rows, num_rows, col, num_cols, args->partial + col);
+    }
+  }
+}
+
+/* Compute y = alpha * op(A) * x + beta * y for the row-major m-by-n matrix A with leading dimension lda. */
+int mylib_matrix_gemv(mylib_ThreadControl tcontrol, int trans, int m, int n, double alpha, double *A, int lda, double *x, double beta, double *y)
+{
+  mylib_GemvChunkArgs args = {A, lda, n, x, y, alpha, beta, NULL};
+  double *partials;
+  size_t stride, num_bytes;
+  int begin_index, end_index, t, j, err;
+
+  if (m < 0 || n < 0 || lda < n || (trans != MYLIB_MATRIX_NOTRANS && trans != MYLIB_MATRIX_TRANS))
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  /* Rows are independent, each thread computes the entries of y for its rows */
+  if (trans == MYLIB_MATRIX_NOTRANS)
+    return mylib_apply(tcontrol, m, mylib_gemv_n_chunk, &args);
+
+  /* Transposed: the rows of a thread contribute to all entries of y. Each thread accumulates the column partials of its rows in its own
+   * cache-line-aligned part of a shared buffer, then each thread sums up the partials of all threads for its part of the columns. No atomics needed. */
+  stride    = ((size_t)n + MYLIB_PARTITION_ALIGN - 1) / MYLIB_PARTITION_ALIGN * MYLIB_PARTITION_ALIGN;
+  num_bytes = (size_t)tcontrol->tsize * stride * sizeof(double);
+  if (num_bytes > INT_MAX)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  err = mylib_ThreadControl_malloc(tcontrol, (int)num_bytes, (void **)&partials);
+  if (err)
+    return err;
+
+  args.partial = partials + tcontrol->tid * stride;
+  memset(args.partial, 0, n * sizeof(double));
+
+  err = mylib_apply(tcontrol, m, mylib_gemv_t_chunk, &args);
+
+  /* All partials are complete */
+  mylib_ThreadControl_sync(tcontrol);
+
+  mylib_partition(tcontrol, n, &begin_index, &end_index);
+  if (begin_index < end_index)
+  {
+    const mylib_Kernels *kernels = mylib_kernels();
+
+    /* Sum up in the partials of thread 0, whose part for these columns is not accessed by any other thread now */
+    for (t = 1; t < tcontrol->tsize; ++t)
+      kernels->add(partials + begin_index, partials + t * stride + begin_index, partials + begin_index, end_index - begin_index);
+
+    for (j = begin_index; j < end_index; ++j)
+      y[j] = (beta == 0) ? alpha * partials[j] : alpha * partials[j] + beta * y[j];
+  }
+
+  mylib_ThreadControl_free(tcontrol, partials);
+  return err;
+}
+
+
+/************** Dense matrix-matrix product ****************/
+
+/* Block sizes of the loops around the kernel, chosen as multiples of the tile sizes of all kernels (4x4, 6x8, 8x16).
+ * Each thread packs its own MC-by-KC block of A (288 KiB), which stays in its L2 cache. A KC-by-NC block of B (at most 2 MiB) is packed once per column
+ * of the thread grid and shared by the threads of the column; NC is reduced so that the blocks of all columns fit into half of the last-level cache.
+ * A KC-by-NR panel of B (at most 32 KiB) stays in the L1 cache while the kernel sweeps over the panels of A. */
+#define MYLIB_GEMM_MC  144
+#define MYLIB_GEMM_KC  256
+#define MYLIB_GEMM_NC  1024
+
+/* Upper bound on the tile size of the kernels, for partial tiles at the boundaries of C */
+#define MYLIB_GEMM_MAX_TILE  128
+
+/* Returns the range [*begin, *end) of part 'part' out of 'parts' of size entries, with blocks aligned to a multiple of align. */
+static void mylib_gemm_range(int size, int parts, int part, int align, int *begin, int *end)
+{
+  int block = ((size + parts - 1) / parts + align - 1) / align * align;
+
+  *begin = (part * block < size) ? part * block : size;
+  *end   = (*begin + block < size) ? *begin + block : size;
+}
+
+/* Arranges tsize threads in a tm-by-tn grid over C such that the regions of the threads are as square as possible,
+ * which minimizes the parts of A and B each thread has to pack. */
+static void mylib_gemm_grid(int m, int n, int tsize, int *tm, int *tn)
+{
+  double best = -1;
+  int d;
+
+  *tm = tsize;
+  *tn = 1;
+  for (d = 1; d <= tsize; ++d)
+  {
+    double rows, cols, ratio;
+
+    if (tsize % d)
+      continue;
+
+    rows  = (double)m / (tsize / d) + 1;
+    cols  = (double)n / d + 1;
+    ratio = (rows < cols) ? rows / cols : cols / rows;
+    if (ratio > best)
+    {
+      best = ratio;
+      *tm  = tsize / d;
+      *tn  = d;
+    }
+  }
+}
+
+/* Packs the mc-by-kc block of alpha * op(A) starting at (i0, p0) into panels of mr rows, stored column by column. Rows beyond mc are padded with zeros. */
+static void mylib_gemm_pack_a(int transa, const double *A, int lda, int i0, int p0, int mc, int kc, int mr, double alpha, double *packed)
+{
+  int ir, p, i;
+
+  for (ir = 0; ir < mc; ir += mr)
+  {
+    for (p = 0; p < kc; ++p)
+    {
+      for (i = 0; i < mr; ++i)
+      {
+        int row = i0 + ir + i, col = p0 + p;
+
+        if (ir + i < mc)
+          *packed++ = alpha * (transa ? A[(size_t)col * lda + row] : A[(size_t)row * lda + col]);
+        else
+          *packed++ = 0;
+      }
+    }
+  }
+}
+
+/* Packs the kc-by-nc block of op(B) starting at (p0, j0) into panels of nr columns, stored row by row. Columns beyond nc are padded with zeros. */
+static void mylib_gemm_pack_b(int transb, const double *B, int ldb, int p0, int j0, int kc, int nc, int nr, double *packed)
+{
+  int jr, p, j;
+
+  for (jr = 0; jr < nc; jr += nr)
+  {
+    for (p = 0; p < kc; ++p)
+    {
+      int row = p0 + p;
+
+      if (!transb && jr + nr <= nc)
+      {
+        /* Full panel of a row-major B: a contiguous copy */
+        memcpy(packed, B + (size_t)row * ldb + j0 + jr, nr * sizeof(double));
+        packed += nr;
+        continue;
+      }
+
+      for (j = 0; j < nr; ++j)
+      {
+        int col = j0 + jr + j;
+
+        if (jr + j < nc)
+          *packed++ = transb ? B[(size_t)col * ldb + row] : B[(size_t)row * ldb + col];
+        else
+          *packed++ = 0;
+      }
+    }
+  }
+}
+
+/* Returns the number of columns of a block of B, such that tn packed KC-by-nc blocks take at most half of the last-level cache. A multiple of nr. */
+static int mylib_gemm_nc(int tn, int nr)
+{
+  long cache_bytes = mylib_topology_cache_bytes();
+  long nc = MYLIB_GEMM_NC;
+
+  /* Unknown cache size: keep the default */
+  if (cache_bytes > 0)
+  {
+    long fit = cache_bytes / 2 / ((long)tn * MYLIB_GEMM_KC * sizeof(double));
+
+    if (fit < nc)
+      nc = fit;
+  }
+
+  nc = nc / nr * nr;
+  return (nc < nr) ? nr : (int)nc;
+}
+
+/* Multiplies the packed mc-by-kc block of A with the packed kc-by-nc block of B and adds the result to the block of C at c. */
+static void mylib_gemm_macro(const mylib_Kernels *kernels, int mc, int nc, int kc, const double *packed_a, const double *packed_b, double *c, int ldc)
+{
+  int mr = kernels->gemm_mr, nr = kernels->gemm_nr;
+  double tile[MYLIB_GEMM_MAX_TILE];
+  int ir, jr, i, j;
+
+  for (jr = 0; jr < nc; jr += nr)
+  {
+    for (ir = 0; ir < mc; ir += mr)
+    {
+      const double *a = packed_a + (size_t)ir * kc;
+      const double *b = packed_b + (size_t)jr * kc;
+      double *c_tile  = c + (size_t)ir * ldc + jr;
+
+      if (ir + mr <= mc && jr + nr <= nc)
+      {
+        kernels->gemm(kc, a, b, c_tile, ldc);
+        continue;
+      }
+
+      /* Partial tile at the boundary of C: compute the full tile on the stack and add the valid part */
+      memset(tile, 0, mr * nr * sizeof(double));
+      kernels->gemm(kc, a, b, tile, nr);
+      for (i = 0; i < mr && ir + i < mc; ++i)
+        for (j = 0; j < nr && jr + j < nc; ++j)
+          c_tile[(size_t)i * ldc + j] += tile[i * nr + j];
+    }
+  }
+}
+
+/* Compute C = alpha * op(A) * op(B) + beta * C for the row-major m-by-k matrix op(A), k-by-n matrix op(B), and m-by-n matrix C. */
+int mylib_matrix_gemm(mylib_ThreadControl tcontrol, int transa, int transb, int m, int n, int k,
+                      double alpha, double *A, int lda, double *B, int ldb, double beta, double *C, int ldc)
+{
+  const mylib_Kernels *kernels = mylib_kernels();
+  double *scratch, *packed_a, *packed_b;
+  int tm, tn, row_begin, row_end, col_begin, col_end, first_begin, col_block, nc_block;
+  int ic, jc, pc, i, err;
+
+  if (m < 0 || n < 0 || k < 0 || ldc < n
+      || (transa != MYLIB_MATRIX_NOTRANS && transa != MYLIB_MATRIX_TRANS) || lda < (transa ? m : k)
+      || (transb != MYLIB_MATRIX_NOTRANS && transb != MYLIB_MATRIX_TRANS) || ldb < (transb ? k : n))
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  /* The threads work on disjoint rectangular regions of C. Each thread packs the part of A it needs, the threads of a column of the grid share B. */
+  mylib_gemm_grid(m, n, tcontrol->tsize, &tm, &tn);
+  mylib_gemm_range(m, tm, tcontrol->tid / tn, kernels->gemm_mr, &row_begin, &row_end);
+  mylib_gemm_range(n, tn, tcontrol->tid % tn, kernels->gemm_nr, &col_begin, &col_end);
+
+  /* C = beta * C on the region of the thread. As in the BLAS, C is not read if beta is zero. */
+  for (i = row_begin; i < row_end && beta != 1; ++i)
+  {
+    if (beta == 0)
+      memset(C + (size_t)i * ldc + col_begin, 0, (col_end - col_begin) * sizeof(double));
+    else
+      kernels->scal(beta, C + (size_t)i * ldc + col_begin, col_end - col_begin);
+  }
+
+  if (alpha == 0 || k == 0)
+    return MYLIB_SUCCESS;
+
+  /* Packing buffers from the arena, no allocation once the arena is large enough: a block of A per thread, followed by a block of B per column of the grid */
+  nc_block = mylib_gemm_nc(tn, kernels->gemm_nr);
+  err = mylib_ThreadControl_malloc(tcontrol, (tcontrol->tsize * MYLIB_GEMM_MC + tn * nc_block) * MYLIB_GEMM_KC * (int)sizeof(double), (void **)&scratch);
+  if (err)
+    return err;
+  packed_a = scratch + (size_t)tcontrol->tid * MYLIB_GEMM_MC * MYLIB_GEMM_KC;
+  packed_b = scratch + ((size_t)tcontrol->tsize * MYLIB_GEMM_MC + (size_t)(tcontrol->tid % tn) * nc_block) * MYLIB_GEMM_KC;
+
+  /* All threads pass the same number of blocks of B, since they synchronize for each: the column range of the first column of the grid is the widest */
+  mylib_gemm_range(n, tn, 0, kernels->gemm_nr, &first_begin, &col_block);
+
+  for (jc = 0; jc < col_block; jc += nc_block)
+  {
+    int nc = col_end - col_begin - jc;
+
+    if (nc > nc_block)
+      nc = nc_block;
+
+    for (pc = 0; pc < k; pc += MYLIB_GEMM_KC)
+    {
+      int kc = (k - pc < MYLIB_GEMM_KC) ? k - pc : MYLIB_GEMM_KC;
+
+      /* The tm threads of a grid column pack a share of the panels of B each */
+      if (nc > 0)
+      {
+        int panel_begin, panel_end, nr = kernels->gemm_nr;
+
+        mylib_gemm_range((nc + nr - 1) / nr, tm, tcontrol->tid / tn, 1, &panel_begin, &panel_end);
+        if (panel_begin < panel_end)
+          mylib_gemm_pack_b(transb, B, ldb, pc, col_begin + jc + panel_begin * nr, kc,
+                            ((panel_end * nr < nc) ? panel_end * nr : nc) - panel_begin * nr, nr, packed_b + (size_t)panel_begin * nr * kc);
+      }
+
+      /* The block of B is complete */
+      mylib_ThreadControl_sync(tcontrol);
+
+      for (ic = row_begin; ic < row_end && nc > 0; ic += MYLIB_GEMM_MC)
+      {
+        int mc = (row_end - ic < MYLIB_GEMM_MC) ? row_end - ic : MYLIB_GEMM_MC;
+
+        mylib_gemm_pack_a(transa, A, lda, ic, pc, mc, kc, kernels->gemm_mr, alpha, packed_a);
+        mylib_gemm_macro(kernels, mc, nc, kc, packed_a, packed_b, C + (size_t)ic * ldc + col_begin + jc, ldc);
+      }
+
+      /* All threads are done with the block of B before it is overwritten */
+      mylib_ThreadControl_sync(tcontrol);
+    }
+  }
+
+  return mylib_ThreadControl_free(tcontrol, scratch);
+}
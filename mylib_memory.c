@@ -0,0 +1,397 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "mylib_internal.h"
+
+
+/************** NUMA memory policies ****************/
+
+/* Memory policy modes of the Linux mbind() system call, see <numaif.h>. Repeated here to avoid a dependency on libnuma. */
+#define MYLIB_MPOL_BIND        2
+#define MYLIB_MPOL_INTERLEAVE  3
+
+/* Maximum number of NUMA nodes supported in a node mask */
+#define MYLIB_MAX_NODES  1024
+
+/* Applies the memory policy mode to the pages in [addr, addr + num_bytes), restricted to the nodes in [first_node, last_node].
+ * addr must be page-aligned. Pages which are already backed by memory are not moved. Returns nonzero if not supported. */
+static int mylib_mbind(void *addr, size_t num_bytes, int mode, int first_node, int last_node)
+{
+#ifdef __linux__
+  unsigned long nodemask[MYLIB_MAX_NODES / (8 * sizeof(unsigned long))];
+  int node;
+
+  if (num_bytes == 0)
+    return 0;
+  if (first_node < 0 || last_node >= MYLIB_MAX_NODES)
+    return 1;
+
+  memset(nodemask, 0, sizeof(nodemask));
+  for (node = first_node; node <= last_node; ++node)
+    nodemask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+
+  return syscall(SYS_mbind, addr, num_bytes, mode, nodemask, (unsigned long)MYLIB_MAX_NODES + 1, 0) != 0;
+#else
+  return 1;
+#endif
+}
+
+
+/************** Arena for mylib_ThreadControl_malloc() ****************/
+
+/* Maximum number of blocks of an arena. Block sizes double, so this is never reached in practice. */
+#define MYLIB_ARENA_MAX_BLOCKS  32
+
+/* Size of the first block of an arena */
+#define MYLIB_ARENA_MIN_BLOCK   65536
+
+/* Bump allocator of a team. Blocks are never moved or released before the factory is destroyed,
+ * so buffers stay valid while the arena grows. Each thread keeps its position (block, offset) in its thread control object. */
+struct mylib_Arena_s
+{
+  int num_blocks;
+  char *blocks[MYLIB_ARENA_MAX_BLOCKS];
+  size_t block_size[MYLIB_ARENA_MAX_BLOCKS];
+};
+
+/* Appends a block of at least num_bytes bytes to *arena, creating the arena if needed. Called by a single thread. */
+static int mylib_arena_grow(mylib_Arena *arena_ptr, size_t num_bytes)
+{
+  mylib_Arena arena = *arena_ptr;
+  size_t size = MYLIB_ARENA_MIN_BLOCK;
+
+  if (!arena)
+  {
+    arena = (mylib_Arena)malloc(sizeof(struct mylib_Arena_s));
+    if (!arena)
+      return MYLIB_ERROR_OUT_OF_MEMORY;
+    arena->num_blocks = 0;
+    *arena_ptr = arena;
+  }
+
+  if (arena->num_blocks == MYLIB_ARENA_MAX_BLOCKS)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  if (arena->num_blocks > 0)
+    size = 2 * arena->block_size[arena->num_blocks - 1];
+  while (size < num_bytes)
+    size *= 2;
+
+  arena->blocks[arena->num_blocks] = (char *)mylib_aligned_malloc(size);
+  if (!arena->blocks[arena->num_blocks])
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  arena->block_size[arena->num_blocks] = size;
+  ++arena->num_blocks;
+  return MYLIB_SUCCESS;
+}
+
+/* Hands out num_bytes bytes at the arena position of tcontrol. Grows the arena collectively if needed. */
+int mylib_arena_alloc(mylib_ThreadControl tcontrol, size_t num_bytes, void **ptr)
+{
+  mylib_Arena *arena_ptr = &tcontrol->shared_context->teams[tcontrol->team].arena;
+  size_t size = (num_bytes + MYLIB_CACHE_LINE - 1) / MYLIB_CACHE_LINE * MYLIB_CACHE_LINE;
+
+  if (size == 0)
+    size = MYLIB_CACHE_LINE;
+
+  /* The memory may have been released by a mylib_ThreadControl_free() which other threads did not reach yet */
+  if (tcontrol->sync_pending)
+    mylib_ThreadControl_wait(tcontrol, tcontrol->sync_token);
+
+  for (;;)
+  {
+    mylib_Arena arena = *arena_ptr;
+
+    if (arena && tcontrol->arena_block < arena->num_blocks)
+    {
+      if (tcontrol->arena_offset + size <= arena->block_size[tcontrol->arena_block])
+      {
+        *ptr = arena->blocks[tcontrol->arena_block] + tcontrol->arena_offset;
+        tcontrol->arena_offset += size;
+        return MYLIB_SUCCESS;
+      }
+
+      /* Does not fit into the remainder of the block, continue with the next one */
+      ++tcontrol->arena_block;
+      tcontrol->arena_offset = 0;
+      continue;
+    }
+
+    /* All threads are at the same position, hence run out of blocks at the same time. The arena is only modified between the two syncs below. */
+    mylib_ThreadControl_sync(tcontrol);
+    if (tcontrol->tid == 0)
+      mylib_arena_grow(arena_ptr, size);
+    mylib_ThreadControl_sync(tcontrol);
+
+    if (!*arena_ptr || tcontrol->arena_block >= (*arena_ptr)->num_blocks)
+      return MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+}
+
+/* Moves the arena position of tcontrol back to ptr, which must have been obtained from mylib_arena_alloc(). */
+int mylib_arena_release(mylib_ThreadControl tcontrol, void *ptr)
+{
+  mylib_Arena arena = tcontrol->shared_context->teams[tcontrol->team].arena;
+  int i;
+
+  for (i = 0; arena && i < arena->num_blocks; ++i)
+  {
+    if (arena->blocks[i] <= (char *)ptr && (char *)ptr < arena->blocks[i] + arena->block_size[i])
+    {
+      tcontrol->arena_block  = i;
+      tcontrol->arena_offset = (char *)ptr - arena->blocks[i];
+      return MYLIB_SUCCESS;
+    }
+  }
+
+  return MYLIB_ERROR_INVALID_ARGUMENT;
+}
+
+/* Releases all blocks of the arena. NULL is ignored. */
+void mylib_arena_destroy(mylib_Arena arena)
+{
+  int i;
+
+  if (!arena)
+    return;
+
+  for (i = 0; i < arena->num_blocks; ++i)
+    free(arena->blocks[i]);
+  free(arena);
+}
+
+
+/************** Vector allocation ****************/
+
+/* Size of a huge page on x86-64 (and the default of most other 64-bit platforms) */
+#define MYLIB_HUGE_PAGE_SIZE  ((size_t)2 * 1024 * 1024)
+
+/* Bookkeeping of a vector, stored right before its first entry */
+typedef struct
+{
+  void *base;       /* start of the allocation */
+  size_t length;    /* length of the mapping, 0 if obtained from posix_memalign() */
+} mylib_VectorHeader;
+
+/* Result of the allocation on thread 0, broadcast to the team */
+typedef struct
+{
+  double *v;
+  size_t page_size;   /* size of the pages backing v */
+} mylib_VectorInfo;
+
+static size_t mylib_round_up(size_t num_bytes, size_t multiple)
+{
+  return (num_bytes + multiple - 1) / multiple * multiple;
+}
+
+#ifdef __linux__
+/* Returns nonzero if transparent huge pages are enabled for ranges advised with MADV_HUGEPAGE, according to /sys/kernel/mm/transparent_hugepage/enabled */
+static int mylib_thp_enabled(void)
+{
+  FILE *file = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+  char line[64];
+  int enabled = 0;
+
+  if (!file)
+    return 0;
+
+  /* The active mode is in brackets: "always [madvise] never" */
+  if (fgets(line, sizeof(line), file))
+    enabled = (strstr(line, "[always]") || strstr(line, "[madvise]"));
+
+  fclose(file);
+  return enabled;
+}
+#endif
+
+/* Reserves address space for num_bytes bytes, aligned to the page size, with the header in front. flags are the MYLIB_MEMORY_HUGE* bits. */
+static mylib_VectorInfo mylib_vector_reserve(size_t num_bytes, int flags)
+{
+  mylib_VectorInfo info = {NULL, (size_t)sysconf(_SC_PAGESIZE)};
+  mylib_VectorHeader *header;
+  char *base = NULL, *data = NULL;
+  size_t length = 0;
+
+#ifdef __linux__
+  if (flags & MYLIB_MEMORY_HUGETLB)
+  {
+    /* Explicit huge pages from the pool configured in /proc/sys/vm/nr_hugepages. The pool is scarce, so the header gets a regular page:
+     * reserve address space, then map the huge pages at a 2 MiB boundary and the header page right in front of them. */
+    size_t huge_bytes = mylib_round_up(num_bytes, MYLIB_HUGE_PAGE_SIZE);
+
+    length = huge_bytes + MYLIB_HUGE_PAGE_SIZE;
+    base = (char *)mmap(NULL, length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+      base = NULL;
+    else
+    {
+      data = base + MYLIB_HUGE_PAGE_SIZE - (uintptr_t)base % MYLIB_HUGE_PAGE_SIZE;
+      if (mmap(data, huge_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_FIXED, -1, 0) == MAP_FAILED ||
+          mmap(data - info.page_size, info.page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED)
+      {
+        munmap(base, length);
+        base = NULL;   /* pool empty or not configured, fall back to transparent huge pages */
+      }
+      else
+        info.page_size = MYLIB_HUGE_PAGE_SIZE;
+    }
+  }
+
+  if (!base && (flags & (MYLIB_MEMORY_HUGEPAGES | MYLIB_MEMORY_HUGETLB)))
+  {
+    /* Transparent huge pages need 2 MiB-aligned ranges, so over-allocate and align by hand */
+    length = mylib_round_up(num_bytes, MYLIB_HUGE_PAGE_SIZE) + MYLIB_HUGE_PAGE_SIZE;
+    base = (char *)mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+      return info;
+
+    data = base + MYLIB_HUGE_PAGE_SIZE - (uintptr_t)base % MYLIB_HUGE_PAGE_SIZE;
+
+    /* Without transparent huge pages the range stays backed by regular pages, and the page placement has to work on those */
+    if (madvise(data, mylib_round_up(num_bytes, MYLIB_HUGE_PAGE_SIZE), MADV_HUGEPAGE) == 0 && mylib_thp_enabled())
+      info.page_size = MYLIB_HUGE_PAGE_SIZE;
+  }
+#endif
+
+  if (!base)
+  {
+    /* Regular pages. The header occupies the first page. The vector is rounded up to whole pages, so that mbind() on its last page
+     * does not apply to other allocations of the heap. */
+    if (posix_memalign((void **)&base, info.page_size, mylib_round_up(num_bytes, info.page_size) + info.page_size) != 0)
+      return info;
+    data   = base + info.page_size;
+    length = 0;
+  }
+
+  header = (mylib_VectorHeader *)data - 1;
+  header->base   = base;
+  header->length = length;
+
+  info.v = (double *)data;
+  return info;
+}
+
+/* Allocates a vector of vsize doubles shared by all threads in tcontrol, placing its pages according to policy (MYLIB_MEMORY_*). */
+int mylib_vector_alloc(mylib_ThreadControl tcontrol, int vsize, int policy, double **v)
+{
+  int placement = policy & ~(MYLIB_MEMORY_HUGEPAGES | MYLIB_MEMORY_HUGETLB);
+  size_t num_bytes = (vsize > 0 ? (size_t)vsize : 1) * sizeof(double);
+  mylib_VectorInfo info = {NULL, 0};
+  double *ptr;
+  int i, begin_index, end_index, num_nodes, err;
+
+  if (vsize < 0 || (placement != MYLIB_MEMORY_FIRST_TOUCH && placement != MYLIB_MEMORY_INTERLEAVE && placement != MYLIB_MEMORY_BIND))
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  /* Pages are not backed by memory until first written, so thread 0 only reserves the address range */
+  if (tcontrol->tid == 0)
+  {
+    info = mylib_vector_reserve(num_bytes, policy);
+
+    if (info.v && placement == MYLIB_MEMORY_INTERLEAVE && mylib_get_topology(NULL, NULL, &num_nodes) == MYLIB_SUCCESS)
+      mylib_mbind(info.v, mylib_round_up(num_bytes, info.page_size), MYLIB_MPOL_INTERLEAVE, 0, num_nodes - 1);
+  }
+
+  err = mylib_ThreadControl_bcast(tcontrol, &info, sizeof(info), 0);
+  if (err)
+  {
+    if (tcontrol->tid == 0)
+      mylib_vector_free(info.v);
+    return err;
+  }
+  if (!info.v)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+  ptr = info.v;
+
+  mylib_partition(tcontrol, vsize, &begin_index, &end_index);
+
+  /* Bind the pages the thread's part begins in or covers to the thread's node. Both ends are rounded down to a page, so a page holding the boundary
+   * between two threads is bound by the later thread, whose part begins in it; the earlier thread's range stops short of it. */
+  if (placement == MYLIB_MEMORY_BIND)
+  {
+    if (tcontrol->node >= 0 && begin_index < end_index)
+    {
+      size_t page_begin = begin_index * sizeof(double) / info.page_size * info.page_size;
+      size_t page_end   = (end_index == vsize) ? mylib_round_up(num_bytes, info.page_size)
+                                               : end_index * sizeof(double) / info.page_size * info.page_size;
+
+      if (page_begin < page_end)
+        mylib_mbind((char *)ptr + page_begin, page_end - page_begin, MYLIB_MPOL_BIND, tcontrol->node, tcontrol->node);
+    }
+
+    /* All pages need to be bound before the first thread touches a shared boundary page */
+    mylib_ThreadControl_sync(tcontrol);
+  }
+
+  /* First touch with the same partition the worker routines use */
+  for (i = begin_index; i < end_index; ++i)
+    ptr[i] = 0;
+
+  mylib_ThreadControl_sync(tcontrol);
+
+  *v = ptr;
+  return MYLIB_SUCCESS;
+}
+
+/* Releases a vector obtained from mylib_vector_alloc(). NULL is ignored. */
+void mylib_vector_free(double *v)
+{
+  mylib_VectorHeader *header;
+
+  if (!v)
+    return;
+
+  header = (mylib_VectorHeader *)v - 1;
+#ifdef __linux__
+  if (header->length)
+  {
+    munmap(header->base, header->length);
+    return;
+  }
+#endif
+  free(header->base);
+}
+
+/* Allocates a vector of vsize floats shared by all threads in tcontrol. Pairs of floats take the place of a double,
+ * so that the pages are placed according to the partition of the single precision worker routines. */
+int mylib_vector_alloc_float(mylib_ThreadControl tcontrol, int vsize, int policy, float **v)
+{
+  double *ptr;
+  int err;
+
+  if (vsize < 0)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  err = mylib_vector_alloc(tcontrol, vsize / 2 + vsize % 2, policy, &ptr);
+  if (err)
+    return err;
+
+  *v = (float *)ptr;
+  return MYLIB_SUCCESS;
+}
+
+/* Releases a vector obtained from mylib_vector_alloc_float(). NULL is ignored. */
+void mylib_vector_free_float(float *v)
+{
+  mylib_vector_free((double *)v);
+}
+
+/* Returns the index range [*begin, *end) of the vsize vector entries the calling thread works on with MYLIB_SCHEDULE_STATIC. */
+int mylib_vector_partition(mylib_ThreadControl tcontrol, int vsize, int *begin, int *end)
+{
+  if (vsize < 0)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  mylib_partition(tcontrol, vsize, begin, end);
+  return MYLIB_SUCCESS;
+}
@@ -0,0 +1,184 @@
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "mylib_internal.h"
+
+
+/************** Persistent worker pool ****************/
+
+/* Worker pool owned by a ThreadFactory. The calling thread of mylib_run() acts as thread 0, the pool provides threads 1, ..., num_threads-1.
+ * Between calls the workers wait in the factory's hybrid barrier, i.e. they spin briefly and then park.
+ * A call to mylib_run() crosses this barrier twice: once to launch the workers, once to wait for their completion. */
+struct mylib_Pool_s
+{
+  int num_threads;
+  pthread_t *workers;                 /* threads 1, ..., num_threads-1 */
+  mylib_ThreadControl *tcontrol;      /* persistent thread control objects, indexed by tid */
+
+  /* current job, published by the launch barrier */
+  void (*fn)(mylib_ThreadControl tcontrol, void *arg);
+  void *arg;
+  int shutdown;
+
+  /* start gate: workers enter the barrier only once all of them were created, so that a failed pthread_create() can be undone */
+  pthread_mutex_t gate_lock;
+  pthread_cond_t gate_cond;
+  int gate_open;
+};
+
+
+/* Main loop of a pool worker: wait for launch, run the job, signal completion. data is the worker's thread control object. */
+static void *mylib_pool_worker(void *data)
+{
+  mylib_ThreadControl tcontrol = (mylib_ThreadControl)data;
+  mylib_Pool pool = tcontrol->shared_context->pool;
+
+  pthread_mutex_lock(&pool->gate_lock);
+  while (!pool->gate_open)
+    pthread_cond_wait(&pool->gate_cond, &pool->gate_lock);
+  pthread_mutex_unlock(&pool->gate_lock);
+
+  /* Not all workers could be created: leave without entering the barrier */
+  if (pool->shutdown)
+    return NULL;
+
+  for (;;)
+  {
+    mylib_ThreadControl_sync(tcontrol);   /* launch */
+
+    if (pool->shutdown)
+      break;
+
+    pool->fn(tcontrol, pool->arg);
+
+    mylib_ThreadControl_sync(tcontrol);   /* completion */
+  }
+
+  return NULL;
+}
+
+/* Releases the thread control objects and the memory of a pool whose workers have been joined */
+static void mylib_pool_free(mylib_ThreadFactory tfactory, mylib_Pool pool)
+{
+  int i;
+
+  for (i = 0; i < pool->num_threads; ++i)
+    mylib_ThreadFactory_destroy_control(tfactory, pool->tcontrol[i]);
+
+  pthread_cond_destroy(&pool->gate_cond);
+  pthread_mutex_destroy(&pool->gate_lock);
+  free(pool->workers);
+  free(pool->tcontrol);
+  free(pool);
+}
+
+/* Creates a pool of num_threads-1 worker threads for tfactory and registers it in tfactory->pool. The factory's sync routine must be set up for num_threads threads. */
+int mylib_pool_create(mylib_ThreadFactory tfactory, int num_threads)
+{
+  int i, err = MYLIB_SUCCESS;
+  mylib_Pool new_pool = (mylib_Pool)malloc(sizeof(struct mylib_Pool_s));
+
+  if (!new_pool)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  new_pool->num_threads = num_threads;
+  new_pool->fn          = NULL;
+  new_pool->arg         = NULL;
+  new_pool->shutdown    = 0;
+  new_pool->gate_open   = 0;
+  new_pool->workers     = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+  new_pool->tcontrol    = (mylib_ThreadControl *)calloc(num_threads, sizeof(mylib_ThreadControl));
+  if (!new_pool->workers || !new_pool->tcontrol)
+  {
+    free(new_pool->workers);
+    free(new_pool->tcontrol);
+    free(new_pool);
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+
+  for (i = 0; i < num_threads && !err; ++i)
+  {
+    err = mylib_ThreadFactory_create_control(tfactory, new_pool->tcontrol + i);
+    if (!err)
+    {
+      new_pool->tcontrol[i]->tid   = i;
+      new_pool->tcontrol[i]->tsize = num_threads;
+    }
+  }
+
+  if (err)
+  {
+    for (i = 0; i < num_threads; ++i)
+      if (new_pool->tcontrol[i])
+        mylib_ThreadFactory_destroy_control(tfactory, new_pool->tcontrol[i]);
+    free(new_pool->workers);
+    free(new_pool->tcontrol);
+    free(new_pool);
+    return err;
+  }
+
+  pthread_mutex_init(&new_pool->gate_lock, NULL);
+  pthread_cond_init(&new_pool->gate_cond, NULL);
+
+  /* Workers look up the pool through the factory, so it has to be registered before they start */
+  tfactory->pool = new_pool;
+
+  for (i = 1; i < num_threads; ++i)
+    if (pthread_create(new_pool->workers + i - 1, NULL, mylib_pool_worker, new_pool->tcontrol[i]) != 0)
+      break;
+
+  /* Open the gate. If a worker could not be created, the barrier would never complete: the workers started so far see the shutdown flag and exit */
+  pthread_mutex_lock(&new_pool->gate_lock);
+  new_pool->shutdown  = (i < num_threads);
+  new_pool->gate_open = 1;
+  pthread_cond_broadcast(&new_pool->gate_cond);
+  pthread_mutex_unlock(&new_pool->gate_lock);
+
+  if (i < num_threads)
+  {
+    int num_started = i - 1;
+
+    for (i = 0; i < num_started; ++i)
+      pthread_join(new_pool->workers[i], NULL);
+
+    tfactory->pool = NULL;
+    mylib_pool_free(tfactory, new_pool);
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+
+  return MYLIB_SUCCESS;
+}
+
+/* Stops and joins all workers, then releases the pool. */
+void mylib_pool_destroy(mylib_ThreadFactory tfactory, mylib_Pool pool)
+{
+  int i;
+
+  if (!pool)
+    return;
+
+  pool->shutdown = 1;
+  mylib_ThreadControl_sync(pool->tcontrol[0]);   /* launch, workers see the shutdown flag */
+
+  for (i = 1; i < pool->num_threads; ++i)
+    pthread_join(pool->workers[i - 1], NULL);
+
+  mylib_pool_free(tfactory, pool);
+}
+
+/* Runs fn(tcontrol, arg) on all threads of the pool, with the calling thread as thread 0. Returns after all threads completed fn. */
+int mylib_pool_run(mylib_Pool pool, void (*fn)(mylib_ThreadControl tcontrol, void *arg), void *arg)
+{
+  mylib_ThreadControl tcontrol = pool->tcontrol[0];
+
+  pool->fn  = fn;
+  pool->arg = arg;
+
+  mylib_ThreadControl_sync(tcontrol);   /* launch */
+
+  fn(tcontrol, arg);
+
+  mylib_ThreadControl_sync(tcontrol);   /* completion */
+  return MYLIB_SUCCESS;
+}
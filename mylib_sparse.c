@@ -0,0 +1,348 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mylib_internal.h"
+
+
+/************** Sparse matrix-vector product ****************/
+
+/* Plan of mylib_csr_spmv(): the CSR arrays of the matrix and the rows of each thread */
+struct mylib_CsrPlan_s
+{
+  int m;                 /* number of rows */
+  int n;                 /* number of columns */
+  const int *row_ptr;    /* m + 1 offsets into col_idx and values */
+  const int *col_idx;
+  const double *values;
+
+  int num_threads;       /* size of the team the plan was computed for */
+  int *row_begin;        /* thread t computes the rows [row_begin[t], row_begin[t + 1]), num_threads + 1 entries */
+};
+
+/* Cost of the rows [0, row): their nonzeros plus one per row for loading the row offsets and storing the entry of y.
+ * Strictly increasing in row, so that empty rows are balanced as well. */
+static long mylib_csr_cost(const int *row_ptr, int row)
+{
+  return (long)row_ptr[row] - row_ptr[0] + row;
+}
+
+/* Creates a plan for the CSR matrix (row_ptr, col_idx, values) with m rows and n columns, used by a team of num_threads threads. */
+int mylib_CsrPlan_create(mylib_CsrPlan *plan, int num_threads, int m, int n, const int *row_ptr, const int *col_idx, const double *values)
+{
+  mylib_CsrPlan p;
+  long total_cost;
+  int t;
+
+  if (!plan || num_threads < 1 || m < 0 || n < 0 || !row_ptr)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  p = (mylib_CsrPlan)malloc(sizeof(*p));
+  if (!p)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  p->row_begin = (int *)malloc((num_threads + 1) * sizeof(int));
+  if (!p->row_begin)
+  {
+    free(p);
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+
+  p->m = m;
+  p->n = n;
+  p->row_ptr = row_ptr;
+  p->col_idx = col_idx;
+  p->values  = values;
+  p->num_threads = num_threads;
+
+  /* Thread t starts at the first row whose preceding rows cost at least t / num_threads of the total.
+   * Found by bisection over the row offsets, so the plan takes O(num_threads * log(m)) operations. */
+  total_cost = mylib_csr_cost(row_ptr, m);
+  p->row_begin[0] = 0;
+  for (t = 1; t < num_threads; ++t)
+  {
+    long target = total_cost * t / num_threads;
+    int lo = p->row_begin[t - 1], hi = m;
+
+    while (lo < hi)
+    {
+      int mid = lo + (hi - lo) / 2;
+
+      if (mylib_csr_cost(row_ptr, mid) < target)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    p->row_begin[t] = lo;
+  }
+  p->row_begin[num_threads] = m;
+
+  *plan = p;
+  return MYLIB_SUCCESS;
+}
+
+/* Destroys a plan created by mylib_CsrPlan_create(). */
+int mylib_CsrPlan_destroy(mylib_CsrPlan plan)
+{
+  if (plan)
+  {
+    free(plan->row_begin);
+    free(plan);
+  }
+  return MYLIB_SUCCESS;
+}
+
+/* Compute y = alpha * A * x + beta * y for the CSR matrix A of the plan. */
+int mylib_csr_spmv(mylib_ThreadControl tcontrol, mylib_CsrPlan plan, double alpha, double *x, double beta, double *y)
+{
+  const int *row_ptr, *col_idx;
+  const double *values;
+  int row, j;
+
+  if (!plan || tcontrol->tsize != plan->num_threads)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  row_ptr = plan->row_ptr;
+  col_idx = plan->col_idx;
+  values  = plan->values;
+
+  for (row = plan->row_begin[tcontrol->tid]; row < plan->row_begin[tcontrol->tid + 1]; ++row)
+  {
+    double sum = 0;
+
+    for (j = row_ptr[row]; j < row_ptr[row + 1]; ++j)
+      sum += values[j] * x[col_idx[j]];
+
+    /* As in the BLAS, y is not read if beta is zero */
+    y[row] = (beta == 0) ? alpha * sum : alpha * sum + beta * y[row];
+  }
+
+  return MYLIB_SUCCESS;
+}
+
+
+/************** SELL-C-sigma format ****************/
+
+/* Sliced ELLPACK matrix: the rows are grouped into chunks of c rows, each chunk is padded to its longest row and stored column by column,
+ * so that the kernel processes c rows with the same instructions. Rows are sorted by length within windows of sigma rows to reduce padding. */
+struct mylib_SellMatrix_s
+{
+  int m;                 /* number of rows */
+  int n;                 /* number of columns */
+  int c;                 /* chunk height */
+  int sigma;             /* sorting window */
+  int num_chunks;
+
+  long *chunk_ptr;       /* num_chunks + 1 offsets of the chunks into col_idx and values */
+  int *chunk_width;      /* length of the longest row of each chunk */
+  int *col_idx;          /* entry (r, j) of chunk k is at chunk_ptr[k] + j * c + r, padding has column -1 and is skipped by the kernels ... */
+  double *values;        /* ... and value 0, so that non-finite entries of x do not leak into padded rows */
+  int *perm;             /* row of A stored in row r of chunk k is perm[k * c + r], -1 for rows padding the last chunk */
+
+  int num_threads;       /* size of the team the static split was computed for */
+  int *chunk_begin;      /* with MYLIB_SCHEDULE_STATIC, thread t computes the chunks [chunk_begin[t], chunk_begin[t + 1]), num_threads + 1 entries */
+};
+
+/* Row and length of a row, sorted within the windows of sigma rows */
+typedef struct
+{
+  int length;
+  int row;
+} mylib_SellRow;
+
+/* Longer rows first, rows of equal length in their original order */
+static int mylib_sell_compare(const void *a, const void *b)
+{
+  const mylib_SellRow *ra = (const mylib_SellRow *)a, *rb = (const mylib_SellRow *)b;
+
+  if (ra->length != rb->length)
+    return (ra->length > rb->length) ? -1 : 1;
+  return (ra->row > rb->row) - (ra->row < rb->row);
+}
+
+/* Cost of the chunks [0, chunk): their stored entries including padding plus one per chunk for storing the entries of y.
+ * Strictly increasing in chunk, so that chunks of empty rows are balanced as well. */
+static long mylib_sell_cost(const long *chunk_ptr, int chunk)
+{
+  return chunk_ptr[chunk] + chunk;
+}
+
+/* Converts the m-by-n CSR matrix (row_ptr, col_idx, values) into SELL-C-sigma format with chunk height c and sorting window sigma, used by a team of num_threads threads. */
+int mylib_SellMatrix_create(mylib_SellMatrix *sell, int num_threads, int c, int sigma, int m, int n, const int *row_ptr, const int *col_idx, const double *values)
+{
+  mylib_SellMatrix p;
+  mylib_SellRow *rows;
+  long total_cost;
+  int i, k, r, j, t;
+
+  if (!sell || num_threads < 1 || c < 1 || c > MYLIB_SELL_MAX_CHUNK_HEIGHT || sigma < 1 || m < 0 || n < 0 || !row_ptr)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  p = (mylib_SellMatrix)calloc(1, sizeof(*p));
+  if (!p)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  p->m = m;
+  p->n = n;
+  p->c = c;
+  p->sigma = sigma;
+  p->num_chunks = (m + c - 1) / c;
+  p->num_threads = num_threads;
+
+  rows           = (mylib_SellRow *)malloc((m + 1) * sizeof(mylib_SellRow));
+  p->chunk_ptr   = (long *)malloc((p->num_chunks + 1) * sizeof(long));
+  p->chunk_width = (int *)malloc((p->num_chunks + 1) * sizeof(int));
+  p->perm        = (int *)malloc(((size_t)p->num_chunks * c + 1) * sizeof(int));
+  p->chunk_begin = (int *)malloc((num_threads + 1) * sizeof(int));
+  if (!rows || !p->chunk_ptr || !p->chunk_width || !p->perm || !p->chunk_begin)
+  {
+    free(rows);
+    mylib_SellMatrix_destroy(p);
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+
+  /* Sort the rows by length within each window */
+  for (i = 0; i < m; ++i)
+  {
+    rows[i].length = row_ptr[i + 1] - row_ptr[i];
+    rows[i].row    = i;
+  }
+  for (i = 0; i < m; i += sigma)
+    qsort(rows + i, (m - i < sigma) ? m - i : sigma, sizeof(mylib_SellRow), mylib_sell_compare);
+
+  /* Widths and offsets of the chunks */
+  p->chunk_ptr[0] = 0;
+  for (k = 0; k < p->num_chunks; ++k)
+  {
+    int width = 0;
+
+    for (r = 0; r < c; ++r)
+    {
+      i = k * c + r;
+      p->perm[i] = (i < m) ? rows[i].row : -1;
+      if (i < m && rows[i].length > width)
+        width = rows[i].length;
+    }
+    p->chunk_width[k]   = width;
+    p->chunk_ptr[k + 1] = p->chunk_ptr[k] + (long)width * c;
+  }
+
+  /* Static split as in mylib_CsrPlan_create(): thread t starts at the first chunk whose preceding chunks cost at least t / num_threads of the total.
+   * Equal numbers of chunks per thread would put the long rows of a power-law matrix on few threads. */
+  total_cost = mylib_sell_cost(p->chunk_ptr, p->num_chunks);
+  p->chunk_begin[0] = 0;
+  for (t = 1; t < num_threads; ++t)
+  {
+    long target = total_cost * t / num_threads;
+    int lo = p->chunk_begin[t - 1], hi = p->num_chunks;
+
+    while (lo < hi)
+    {
+      int mid = lo + (hi - lo) / 2;
+
+      if (mylib_sell_cost(p->chunk_ptr, mid) < target)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    p->chunk_begin[t] = lo;
+  }
+  p->chunk_begin[num_threads] = p->num_chunks;
+
+  /* Chunks start on a cache line if c is a multiple of eight */
+  p->col_idx = (int *)mylib_aligned_malloc((p->chunk_ptr[p->num_chunks] + 1) * sizeof(int));
+  p->values  = (double *)mylib_aligned_malloc((p->chunk_ptr[p->num_chunks] + 1) * sizeof(double));
+  if (!p->col_idx || !p->values)
+  {
+    free(rows);
+    mylib_SellMatrix_destroy(p);
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+
+  memset(p->col_idx, -1, p->chunk_ptr[p->num_chunks] * sizeof(int));
+  memset(p->values,  0, p->chunk_ptr[p->num_chunks] * sizeof(double));
+
+  for (k = 0; k < p->num_chunks; ++k)
+    for (r = 0; r < c && k * c + r < m; ++r)
+    {
+      int row = p->perm[k * c + r];
+
+      for (j = 0; j < row_ptr[row + 1] - row_ptr[row]; ++j)
+      {
+        p->col_idx[p->chunk_ptr[k] + (long)j * c + r] = col_idx[row_ptr[row] + j];
+        p->values[p->chunk_ptr[k] + (long)j * c + r]  = values[row_ptr[row] + j];
+      }
+    }
+
+  free(rows);
+  *sell = p;
+  return MYLIB_SUCCESS;
+}
+
+/* Destroys a matrix created by mylib_SellMatrix_create(). */
+int mylib_SellMatrix_destroy(mylib_SellMatrix sell)
+{
+  if (sell)
+  {
+    free(sell->chunk_ptr);
+    free(sell->chunk_width);
+    free(sell->col_idx);
+    free(sell->values);
+    free(sell->perm);
+    free(sell->chunk_begin);
+    free(sell);
+  }
+  return MYLIB_SUCCESS;
+}
+
+/* Arguments of the chunk routine of mylib_sell_spmv(). Each thread passes its own instance. */
+typedef struct
+{
+  mylib_SellMatrix sell;
+  double alpha;
+  double *x;
+  double beta;
+  double *y;
+} mylib_SellChunkArgs;
+
+/* Chunk routine of mylib_sell_spmv(): computes the entries of y for the rows of the chunks [begin_chunk, end_chunk) */
+static void mylib_sell_spmv_chunk(mylib_ThreadControl tcontrol, int begin_chunk, int end_chunk, void *data)
+{
+  mylib_SellChunkArgs *args = (mylib_SellChunkArgs *)data;
+  mylib_SellMatrix sell = args->sell;
+  const mylib_Kernels *kernels = mylib_kernels();
+  double results[MYLIB_SELL_MAX_CHUNK_HEIGHT];
+  int k, r;
+
+  for (k = begin_chunk; k < end_chunk; ++k)
+  {
+    kernels->sell(sell->c, sell->chunk_width[k], sell->values + sell->chunk_ptr[k], sell->col_idx + sell->chunk_ptr[k], args->x, results);
+
+    /* As in the BLAS, y is not read if beta is zero */
+    for (r = 0; r < sell->c; ++r)
+    {
+      int row = sell->perm[k * sell->c + r];
+
+      if (row >= 0)
+        args->y[row] = (args->beta == 0) ? args->alpha * results[r] : args->alpha * results[r] + args->beta * args->y[row];
+    }
+  }
+}
+
+/* Compute y = alpha * A * x + beta * y for the SELL-C-sigma matrix A. */
+int mylib_sell_spmv(mylib_ThreadControl tcontrol, mylib_SellMatrix sell, double alpha, double *x, double beta, double *y)
+{
+  mylib_SellChunkArgs args = {sell, alpha, x, beta, y};
+
+  if (!sell)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  if (tcontrol->shared_context->schedule == MYLIB_SCHEDULE_STEALING)
+    return mylib_apply(tcontrol, sell->num_chunks, mylib_sell_spmv_chunk, &args);
+
+  if (tcontrol->tsize != sell->num_threads)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  mylib_sell_spmv_chunk(tcontrol, sell->chunk_begin[tcontrol->tid], sell->chunk_begin[tcontrol->tid + 1], &args);
+  return MYLIB_SUCCESS;
+}
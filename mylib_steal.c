@@ -0,0 +1,259 @@
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "mylib_internal.h"
+
+
+/************** Chase-Lev work-stealing deque ****************/
+
+/* Number of tasks per deque. Ranges are split in halves and only the upper half is pushed,
+ * so a deque holds at most log2(range / grain) + 1 <= 33 tasks. */
+#define MYLIB_DEQUE_CAPACITY 64
+
+/* A task is an index range [begin, end), packed into 64 bits so that it can be read atomically by thieves. */
+typedef uint64_t mylib_Task;
+
+#define MYLIB_TASK_EMPTY  UINT64_MAX
+
+static mylib_Task mylib_task_pack(int begin, int end)
+{
+  return ((uint64_t)(uint32_t)begin << 32) | (uint32_t)end;
+}
+
+static int mylib_task_begin(mylib_Task task) { return (int)(uint32_t)(task >> 32); }
+static int mylib_task_end(mylib_Task task)   { return (int)(uint32_t)task; }
+
+/* Deque of one thread (Chase, Lev; C11 formulation by Le, Pop, Cohen, Zappa Nardelli).
+ * The owner pushes and takes at the bottom, other threads steal from the top. Each deque occupies its own cache lines. */
+typedef struct
+{
+  _Alignas(MYLIB_CACHE_LINE) atomic_long top;
+  _Alignas(MYLIB_CACHE_LINE) atomic_long bottom;
+  _Atomic mylib_Task tasks[MYLIB_DEQUE_CAPACITY];
+
+  /* private to the owner */
+  unsigned int rng;           /* state for random victim selection */
+  long target;                /* total number of elements scheduled by all parallel loops so far */
+} mylib_Deque;
+
+/* Work-stealing state of a team: one deque per thread and the number of elements completed by all parallel loops so far.
+ * The completion counter is never reset. Each thread adds the size of every loop to its private target, so all threads agree when a loop is done. */
+struct mylib_Steal_s
+{
+  int capacity;
+  mylib_Deque *deques;
+
+  _Alignas(MYLIB_CACHE_LINE) atomic_long completed;
+};
+
+
+/* Pushes a task at the bottom. Returns nonzero if the deque is full. Owner only. */
+static int mylib_deque_push(mylib_Deque *deque, mylib_Task task)
+{
+  long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+
+  if (b - t >= MYLIB_DEQUE_CAPACITY)
+    return 1;
+
+  atomic_store_explicit(&deque->tasks[b % MYLIB_DEQUE_CAPACITY], task, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+  return 0;
+}
+
+/* Takes the most recently pushed task from the bottom. Owner only. */
+static mylib_Task mylib_deque_take(mylib_Deque *deque)
+{
+  long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+  long t;
+  mylib_Task task = MYLIB_TASK_EMPTY;
+
+  atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+  if (t <= b)
+  {
+    task = atomic_load_explicit(&deque->tasks[b % MYLIB_DEQUE_CAPACITY], memory_order_relaxed);
+    if (t == b)
+    {
+      /* last task: race against thieves */
+      if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+        task = MYLIB_TASK_EMPTY;
+      atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    }
+  }
+  else
+  {
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+  }
+
+  return task;
+}
+
+/* Steals the oldest task from the top. Returns MYLIB_TASK_EMPTY if the deque is empty or another thread won the race. */
+static mylib_Task mylib_deque_steal(mylib_Deque *deque)
+{
+  long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+  long b;
+  mylib_Task task;
+
+  atomic_thread_fence(memory_order_seq_cst);
+  b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+  if (t >= b)
+    return MYLIB_TASK_EMPTY;
+
+  task = atomic_load_explicit(&deque->tasks[t % MYLIB_DEQUE_CAPACITY], memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+    return MYLIB_TASK_EMPTY;
+
+  return task;
+}
+
+
+/************** Work-stealing state of a team ****************/
+
+/* Creates the work-stealing state for up to capacity threads. */
+int mylib_steal_create(int capacity, mylib_Steal *steal)
+{
+  mylib_Steal new_steal = (mylib_Steal)mylib_aligned_malloc(sizeof(struct mylib_Steal_s));
+
+  if (!new_steal)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  new_steal->deques = (mylib_Deque *)mylib_aligned_malloc(capacity * sizeof(mylib_Deque));
+  if (!new_steal->deques)
+  {
+    free(new_steal);
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+
+  new_steal->capacity = capacity;
+  atomic_init(&new_steal->completed, 0);
+  mylib_steal_reset(new_steal);
+
+  *steal = new_steal;
+  return MYLIB_SUCCESS;
+}
+
+/* Releases the work-stealing state. NULL is ignored. */
+void mylib_steal_destroy(mylib_Steal steal)
+{
+  if (!steal)
+    return;
+
+  free(steal->deques);
+  free(steal);
+}
+
+/* Resets all deques and counters. Must not be called while any thread is inside a parallel loop. */
+void mylib_steal_reset(mylib_Steal steal)
+{
+  int i, j;
+
+  for (i = 0; i < steal->capacity; ++i)
+  {
+    atomic_store_explicit(&steal->deques[i].top, 0, memory_order_relaxed);
+    atomic_store_explicit(&steal->deques[i].bottom, 0, memory_order_relaxed);
+    for (j = 0; j < MYLIB_DEQUE_CAPACITY; ++j)
+      atomic_store_explicit(&steal->deques[i].tasks[j], MYLIB_TASK_EMPTY, memory_order_relaxed);
+    steal->deques[i].rng    = 2654435761u * (unsigned int)(i + 1);
+    steal->deques[i].target = 0;
+  }
+  atomic_store_explicit(&steal->completed, 0, memory_order_relaxed);
+}
+
+
+/************** Parallel loop ****************/
+
+/* Returns a pseudo-random victim other than tid (xorshift). */
+static int mylib_steal_victim(mylib_Deque *deque, int tid, int tsize)
+{
+  unsigned int x = deque->rng;
+  int victim;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  deque->rng = x;
+
+  victim = (int)(x % (unsigned int)(tsize - 1));
+  return (victim >= tid) ? victim + 1 : victim;
+}
+
+/* Executes body(tcontrol, begin, end, arg) for chunks covering [begin, end) with work stealing. */
+int mylib_ThreadControl_parallel_for(mylib_ThreadControl tcontrol, int begin, int end, int grain,
+                                     void (*body)(mylib_ThreadControl tcontrol, int begin, int end, void *arg), void *arg)
+{
+  mylib_Steal steal;
+  mylib_Deque *own;
+  mylib_Task task;
+  int tid = tcontrol->tid;
+  int task_begin, task_end, err;
+  unsigned int spins = 0;
+
+  if (grain < 1)
+    grain = 1;
+  if (end < begin)
+    end = begin;
+
+  err = mylib_team_get_steal(tcontrol, &steal);
+  if (err)
+    return err;
+  own = steal->deques + tid;
+
+  /* No thread may still be looking for chunks of the previous loop once the first chunk of this loop is pushed */
+  mylib_ThreadControl_sync(tcontrol);
+
+  own->target += end - begin;
+
+  /* Start with the thread's static block, which preserves locality if there is no imbalance */
+  mylib_partition(tcontrol, end - begin, &task_begin, &task_end);
+  task = (task_begin < task_end) ? mylib_task_pack(begin + task_begin, begin + task_end) : MYLIB_TASK_EMPTY;
+
+  for (;;)
+  {
+    if (task == MYLIB_TASK_EMPTY)
+      task = mylib_deque_take(own);
+
+    if (task == MYLIB_TASK_EMPTY && tcontrol->tsize > 1)
+      task = mylib_deque_steal(steal->deques + mylib_steal_victim(own, tid, tcontrol->tsize));
+
+    if (task == MYLIB_TASK_EMPTY)
+    {
+      if (atomic_load_explicit(&steal->completed, memory_order_acquire) >= own->target)
+        break;
+      mylib_spin_pause(&spins);
+      continue;
+    }
+
+    /* Split off the upper half until the chunk is small enough, so that idle threads find work to steal.
+     * As in mylib_partition(), split points are multiples of MYLIB_PARTITION_ALIGN from begin, so that no two threads write to the same cache line. */
+    task_begin = mylib_task_begin(task);
+    task_end   = mylib_task_end(task);
+    while (task_end - task_begin > grain)
+    {
+      int middle = task_begin + (task_end - task_begin) / 2;
+
+      middle = begin + (middle - begin) / MYLIB_PARTITION_ALIGN * MYLIB_PARTITION_ALIGN;
+      if (middle <= task_begin || middle >= task_end)
+        break;
+
+      if (mylib_deque_push(own, mylib_task_pack(middle, task_end)))
+        break;
+      task_end = middle;
+    }
+
+    body(tcontrol, task_begin, task_end, arg);
+
+    atomic_fetch_add_explicit(&steal->completed, task_end - task_begin, memory_order_acq_rel);
+    task = MYLIB_TASK_EMPTY;
+    spins = 0;
+  }
+
+  return MYLIB_SUCCESS;
+}
@@ -0,0 +1,440 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "mylib_internal.h"
+
+
+/************** Per-team state ****************/
+
+/* Slot published by one thread. Each slot occupies a full cache line. */
+typedef struct
+{
+  _Alignas(MYLIB_CACHE_LINE) atomic_long epoch;   /* epoch of the collective for which 'value' is valid */
+  double value;
+  int index;                                      /* location of 'value' for MYLIB_OP_MAXLOC */
+  const double *values;                           /* partial results of mylib_team_reduce_array(), owned by the publishing thread */
+} mylib_TeamSlot;
+
+/* Private state of one thread, only accessed by the thread itself. */
+typedef struct
+{
+  _Alignas(MYLIB_CACHE_LINE) long epoch;          /* number of reductions this thread has entered */
+  long exchanges;                                 /* number of bcast/gather operations this thread has entered */
+} mylib_TeamLocal;
+
+/* State of the collectives of one team.
+ * Collectives are numbered by epochs: since all threads of the team call the collectives in the same order, their private epoch counters agree.
+ * A thread publishes data together with the epoch, so slots never need to be reset. */
+struct mylib_Team_s
+{
+  int capacity;                 /* maximum number of threads */
+  int tsize;                    /* number of threads the epochs refer to */
+
+  mylib_TeamSlot  *slots;
+  mylib_TeamLocal *local;
+
+  /* Scratch for bcast and gather: two halves of MYLIB_COLLECTIVE_MAX_BYTES per thread, used in alternating order.
+   * A half is only reused after the next collective, which every thread enters only after it finished reading. */
+  char *exchange;
+
+  mylib_Steal steal;            /* deques of the work-stealing scheduler */
+
+  /* Per-thread scratch of mylib_ThreadControl_scratch(): capacity slots of scratch_stride bytes, a multiple of the cache line size */
+  char *scratch;
+  int scratch_stride;
+
+  _Alignas(MYLIB_CACHE_LINE) atomic_long result_epoch;   /* epoch of the final result of the last reduction */
+  double result;
+  int result_index;
+};
+
+
+/* Creates the collective state for up to capacity threads. */
+int mylib_team_create(int capacity, mylib_Team *team)
+{
+  int i;
+  mylib_Team new_team = (mylib_Team)mylib_aligned_malloc(sizeof(struct mylib_Team_s));
+
+  if (!new_team)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  new_team->slots = (mylib_TeamSlot *)mylib_aligned_malloc(capacity * sizeof(mylib_TeamSlot));
+  new_team->local = (mylib_TeamLocal *)mylib_aligned_malloc(capacity * sizeof(mylib_TeamLocal));
+  new_team->exchange = (char *)mylib_aligned_malloc(2 * capacity * MYLIB_COLLECTIVE_MAX_BYTES);
+  new_team->steal = NULL;
+  new_team->scratch = NULL;
+  new_team->scratch_stride = 0;
+  if (!new_team->slots || !new_team->local || !new_team->exchange || mylib_steal_create(capacity, &new_team->steal))
+  {
+    free(new_team->slots);
+    free(new_team->local);
+    free(new_team->exchange);
+    mylib_steal_destroy(new_team->steal);
+    free(new_team);
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+
+  new_team->capacity = capacity;
+  new_team->tsize    = capacity;
+  for (i = 0; i < capacity; ++i)
+  {
+    atomic_init(&new_team->slots[i].epoch, 0);
+    new_team->slots[i].value = 0;
+    new_team->slots[i].index = 0;
+    new_team->slots[i].values = NULL;
+    new_team->local[i].epoch = 0;
+    new_team->local[i].exchanges = 0;
+  }
+  atomic_init(&new_team->result_epoch, 0);
+  new_team->result = 0;
+  new_team->result_index = 0;
+
+  *team = new_team;
+  return MYLIB_SUCCESS;
+}
+
+/* Releases the collective state of a team. */
+void mylib_team_destroy(mylib_Team team)
+{
+  if (!team)
+    return;
+
+  free(team->slots);
+  free(team->local);
+  free(team->exchange);
+  free(team->scratch);
+  mylib_steal_destroy(team->steal);
+  free(team);
+}
+
+/* Returns the collective state for the team of tcontrol.
+ * The state is (re)created if the team has none yet, if it is too small, or if the team size changed since the last collective.
+ * All threads of the team take the same decision, since the state is only modified between the two syncs below. */
+int mylib_team_get(mylib_ThreadControl tcontrol, mylib_Team *team)
+{
+  struct mylib_TeamEntry_s *entry = tcontrol->shared_context->teams + tcontrol->team;
+  int i, err = MYLIB_SUCCESS;
+
+  if (entry->team && entry->team->tsize == tcontrol->tsize)
+  {
+    *team = entry->team;
+    return MYLIB_SUCCESS;
+  }
+
+  mylib_ThreadControl_sync(tcontrol);
+
+  if (tcontrol->tid == 0)
+  {
+    if (!entry->team || entry->team->capacity < tcontrol->tsize)
+    {
+      mylib_team_destroy(entry->team);
+      entry->team = NULL;
+      err = mylib_team_create(tcontrol->tsize, &entry->team);
+    }
+    else
+    {
+      /* restart epochs for the new team size */
+      for (i = 0; i < entry->team->capacity; ++i)
+      {
+        atomic_store_explicit(&entry->team->slots[i].epoch, 0, memory_order_relaxed);
+        entry->team->local[i].epoch = 0;
+        entry->team->local[i].exchanges = 0;
+      }
+      atomic_store_explicit(&entry->team->result_epoch, 0, memory_order_relaxed);
+      mylib_steal_reset(entry->team->steal);
+      entry->team->tsize = tcontrol->tsize;
+    }
+  }
+
+  mylib_ThreadControl_sync(tcontrol);
+
+  if (!entry->team)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  *team = entry->team;
+  return err;
+}
+
+/* Returns the work-stealing state for the team of tcontrol, (re)creating it collectively if needed. */
+int mylib_team_get_steal(mylib_ThreadControl tcontrol, mylib_Steal *steal)
+{
+  mylib_Team team;
+  int err = mylib_team_get(tcontrol, &team);
+
+  if (!err)
+    *steal = team->steal;
+  return err;
+}
+
+
+/************** Per-thread scratch ****************/
+
+/* Returns padded per-thread scratch of at least num_bytes bytes. Grows the scratch collectively if needed. */
+int mylib_ThreadControl_scratch(mylib_ThreadControl tcontrol, int num_bytes, void **scratch, int *stride)
+{
+  mylib_Team team;
+  int err;
+
+  if (num_bytes < 0)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  err = mylib_team_get(tcontrol, &team);
+  if (err)
+    return err;
+
+  /* All threads pass the same num_bytes, hence take the same decision. The scratch is only modified between the two syncs below. */
+  if (team->scratch_stride < num_bytes || !team->scratch)
+  {
+    mylib_ThreadControl_sync(tcontrol);
+
+    if (tcontrol->tid == 0)
+    {
+      int new_stride = (num_bytes + MYLIB_CACHE_LINE - 1) / MYLIB_CACHE_LINE * MYLIB_CACHE_LINE;
+
+      if (new_stride == 0)
+        new_stride = MYLIB_CACHE_LINE;
+
+      free(team->scratch);
+      team->scratch = (char *)mylib_aligned_malloc((size_t)team->capacity * new_stride);
+      team->scratch_stride = team->scratch ? new_stride : 0;
+    }
+
+    mylib_ThreadControl_sync(tcontrol);
+
+    if (!team->scratch)
+      return MYLIB_ERROR_OUT_OF_MEMORY;
+  }
+
+  *scratch = team->scratch;
+  *stride  = team->scratch_stride;
+  return MYLIB_SUCCESS;
+}
+
+
+/************** Reductions ****************/
+
+static double mylib_reduce_op(int op, double a, double b)
+{
+  switch (op)
+  {
+  case MYLIB_OP_MIN: return (b < a) ? b : a;
+  case MYLIB_OP_MAX: return (b > a) ? b : a;
+  default:           return a + b;
+  }
+}
+
+/* Spins until the slot was published for the given epoch. */
+static void mylib_team_wait_epoch(atomic_long *slot_epoch, long epoch)
+{
+  unsigned int spins = 0;
+
+  while (atomic_load_explicit(slot_epoch, memory_order_acquire) < epoch)
+    mylib_spin_pause(&spins);
+}
+
+/* Combines the pairs (value, index) of two threads for MYLIB_OP_MAXLOC: the larger value wins, ties go to the smaller index. */
+static void mylib_reduce_maxloc(double *value, int *index, double other_value, int other_index)
+{
+  if (other_value > *value || (other_value == *value && other_index < *index))
+  {
+    *value = other_value;
+    *index = other_index;
+  }
+}
+
+/* Tree reduction. Thread t combines the values of its children 2t+1 and 2t+2 and publishes the partial result in its slot.
+ * Thread 0 returns with the final result while the other threads wait for mylib_team_release(). */
+int mylib_team_reduce(mylib_ThreadControl tcontrol, double value, int index, int op, double *result, int *result_index)
+{
+  mylib_Team team;
+  int tid = tcontrol->tid;
+  int child;
+  long epoch;
+  int err = mylib_team_get(tcontrol, &team);
+
+  if (err)
+    return err;
+
+  epoch = ++team->local[tid].epoch;
+
+  for (child = 2 * tid + 1; child <= 2 * tid + 2 && child < tcontrol->tsize; ++child)
+  {
+    mylib_team_wait_epoch(&team->slots[child].epoch, epoch);
+    if (op == MYLIB_OP_MAXLOC)
+      mylib_reduce_maxloc(&value, &index, team->slots[child].value, team->slots[child].index);
+    else
+      value = mylib_reduce_op(op, value, team->slots[child].value);
+  }
+
+  if (tid > 0)
+  {
+    team->slots[tid].value = value;
+    team->slots[tid].index = index;
+    atomic_store_explicit(&team->slots[tid].epoch, epoch, memory_order_release);
+
+    mylib_team_wait_epoch(&team->result_epoch, epoch);
+    value = team->result;
+    index = team->result_index;
+  }
+
+  *result = value;
+  if (result_index)
+    *result_index = index;
+
+  return MYLIB_SUCCESS;
+}
+
+/* Hands the final result of the current reduction to the waiting threads. Called by thread 0 only, after mylib_team_reduce(). */
+void mylib_team_release(mylib_ThreadControl tcontrol, double result, int result_index)
+{
+  mylib_Team team = tcontrol->shared_context->teams[tcontrol->team].team;
+
+  team->result = result;
+  team->result_index = result_index;
+  atomic_store_explicit(&team->result_epoch, team->local[0].epoch, memory_order_release);
+}
+
+/* Tree reduction of arrays. Instead of copying count values into the slots, each thread publishes a pointer to its array,
+ * which stays valid since the thread does not return before thread 0 releases the team. */
+int mylib_team_reduce_array(mylib_ThreadControl tcontrol, double *values, int count, int op)
+{
+  mylib_Team team;
+  int tid = tcontrol->tid;
+  int child, i;
+  long epoch;
+  int err = mylib_team_get(tcontrol, &team);
+
+  if (err)
+    return err;
+
+  epoch = ++team->local[tid].epoch;
+
+  for (child = 2 * tid + 1; child <= 2 * tid + 2 && child < tcontrol->tsize; ++child)
+  {
+    const double *child_values;
+
+    mylib_team_wait_epoch(&team->slots[child].epoch, epoch);
+    child_values = team->slots[child].values;
+    for (i = 0; i < count; ++i)
+      values[i] = mylib_reduce_op(op, values[i], child_values[i]);
+  }
+
+  if (tid > 0)
+  {
+    team->slots[tid].values = values;
+    atomic_store_explicit(&team->slots[tid].epoch, epoch, memory_order_release);
+
+    mylib_team_wait_epoch(&team->result_epoch, epoch);
+  }
+
+  return MYLIB_SUCCESS;
+}
+
+/* Tree allreduce. Thread 0 stores the final result to *root_result if not NULL, and then releases all threads. */
+int mylib_team_allreduce_double(mylib_ThreadControl tcontrol, double value, int op, double *result, double *root_result)
+{
+  int err = mylib_team_reduce(tcontrol, value, 0, op, result, NULL);
+
+  if (err)
+    return err;
+
+  if (tcontrol->tid == 0)
+  {
+    if (root_result)
+      *root_result = *result;
+    mylib_team_release(tcontrol, *result, 0);
+  }
+
+  return MYLIB_SUCCESS;
+}
+
+/* Combines 'value' of all threads in tcontrol with the reduction operation op and returns the result to all threads. */
+int mylib_ThreadControl_allreduce_double(mylib_ThreadControl tcontrol, double value, int op, double *result)
+{
+  if (op != MYLIB_OP_SUM && op != MYLIB_OP_MIN && op != MYLIB_OP_MAX)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  return mylib_team_allreduce_double(tcontrol, value, op, result, NULL);
+}
+
+
+/************** Broadcast and gather ****************/
+
+/* Returns the scratch of thread tid for the next bcast/gather of the calling thread. */
+static char *mylib_team_exchange_slot(mylib_Team team, mylib_ThreadControl tcontrol, int tid)
+{
+  long half = team->local[tcontrol->tid].exchanges & 1;
+
+  return team->exchange + (half * team->capacity + tid) * MYLIB_COLLECTIVE_MAX_BYTES;
+}
+
+/* Copies num_bytes bytes from buffer of thread root to buffer of all other threads in tcontrol. */
+int mylib_ThreadControl_bcast(mylib_ThreadControl tcontrol, void *buffer, int num_bytes, int root)
+{
+  mylib_Team team;
+  char *scratch;
+  int token;
+  int err;
+
+  if (num_bytes < 0 || num_bytes > MYLIB_COLLECTIVE_MAX_BYTES || root < 0 || root >= tcontrol->tsize)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  err = mylib_team_get(tcontrol, &team);
+  if (err)
+    return err;
+
+  scratch = mylib_team_exchange_slot(team, tcontrol, root);
+  ++team->local[tcontrol->tid].exchanges;
+
+  if (tcontrol->tid == root)
+  {
+    /* The previous synchronization point must be complete before the scratch half can be overwritten */
+    if (tcontrol->sync_pending)
+      mylib_ThreadControl_wait(tcontrol, tcontrol->sync_token);
+
+    memcpy(scratch, buffer, num_bytes);
+    mylib_ThreadControl_arrive(tcontrol, &token);
+  }
+  else
+  {
+    mylib_ThreadControl_arrive(tcontrol, &token);
+    mylib_ThreadControl_wait(tcontrol, token);
+    memcpy(buffer, scratch, num_bytes);
+  }
+
+  return MYLIB_SUCCESS;
+}
+
+/* Collects num_bytes bytes from sendbuf of each thread in tcontrol into recvbuf of thread root, ordered by thread ID. */
+int mylib_ThreadControl_gather(mylib_ThreadControl tcontrol, const void *sendbuf, int num_bytes, void *recvbuf, int root)
+{
+  mylib_Team team;
+  int token;
+  int i, err;
+
+  if (num_bytes < 0 || num_bytes > MYLIB_COLLECTIVE_MAX_BYTES || root < 0 || root >= tcontrol->tsize)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  err = mylib_team_get(tcontrol, &team);
+  if (err)
+    return err;
+
+  /* The previous synchronization point must be complete before the scratch half can be overwritten */
+  if (tcontrol->sync_pending)
+    mylib_ThreadControl_wait(tcontrol, tcontrol->sync_token);
+
+  memcpy(mylib_team_exchange_slot(team, tcontrol, tcontrol->tid), sendbuf, num_bytes);
+  mylib_ThreadControl_arrive(tcontrol, &token);
+
+  if (tcontrol->tid == root)
+  {
+    mylib_ThreadControl_wait(tcontrol, token);
+    for (i = 0; i < tcontrol->tsize; ++i)
+      memcpy((char *)recvbuf + i * num_bytes, mylib_team_exchange_slot(team, tcontrol, i), num_bytes);
+  }
+
+  ++team->local[tcontrol->tid].exchanges;
+  return MYLIB_SUCCESS;
+}
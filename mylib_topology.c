@@ -0,0 +1,384 @@
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE   /* sched_setaffinity(), CPU_SET() */
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "mylib_internal.h"
+
+
+/************** Topology discovery ****************/
+
+/* Hardware thread as seen by the operating system */
+typedef struct
+{
+  int cpu;        /* OS cpu number */
+  int core;       /* dense core index across all packages */
+  int package;    /* physical package (socket) */
+  int node;       /* NUMA node */
+  int sibling;    /* index among the hardware threads of the same core */
+} mylib_CPU;
+
+/* Machine topology, restricted to the cpus the process may run on. Discovered once per process. */
+static struct
+{
+  int num_cpus;
+  int num_cores;
+  int num_nodes;
+  long cache_bytes;  /* aggregate size of the last-level caches of all packages */
+  mylib_CPU *cpus;
+  int *compact;   /* placement order: hardware threads of a core, then cores of a package, then packages of a node */
+  int *scatter;   /* placement order: round-robin over nodes, within a node one hardware thread per core first */
+} mylib_topology;
+
+static pthread_once_t mylib_topology_once = PTHREAD_ONCE_INIT;
+
+
+/* Reads a single integer from a sysfs file. Returns fallback if the file is not available. */
+static int mylib_read_int(const char *path, int fallback)
+{
+  FILE *file = fopen(path, "r");
+  int value;
+
+  if (!file)
+    return fallback;
+  if (fscanf(file, "%d", &value) != 1)
+    value = fallback;
+  fclose(file);
+  return value;
+}
+
+/* Returns nonzero if cpu is contained in the sysfs cpu list in path (format "0-3,8,10-11"). */
+static int mylib_cpulist_contains(const char *path, int cpu)
+{
+  FILE *file = fopen(path, "r");
+  int first, last, found = 0;
+  char separator;
+
+  if (!file)
+    return 0;
+
+  while (!found && fscanf(file, "%d", &first) == 1)
+  {
+    last = first;
+    if (fscanf(file, "%c", &separator) == 1 && separator == '-')
+    {
+      if (fscanf(file, "%d", &last) != 1)
+        break;
+      if (fscanf(file, "%c", &separator) != 1)
+        separator = '\n';
+    }
+    found = (first <= cpu && cpu <= last);
+    if (separator != ',')
+      break;
+  }
+
+  fclose(file);
+  return found;
+}
+
+static int mylib_compare_compact(const void *a, const void *b)
+{
+  const mylib_CPU *x = (const mylib_CPU *)a;
+  const mylib_CPU *y = (const mylib_CPU *)b;
+
+  if (x->node    != y->node)    return x->node    - y->node;
+  if (x->package != y->package) return x->package - y->package;
+  if (x->core    != y->core)    return x->core    - y->core;
+  return x->cpu - y->cpu;
+}
+
+static int mylib_compare_scatter(const void *a, const void *b)
+{
+  const mylib_CPU *x = (const mylib_CPU *)a;
+  const mylib_CPU *y = (const mylib_CPU *)b;
+
+  if (x->sibling != y->sibling) return x->sibling - y->sibling;
+  return mylib_compare_compact(a, b);
+}
+
+/* Returns the size in bytes of the last-level cache of cpu according to /sys/devices/system/cpu/cpuN/cache, 0 if unknown. */
+static long mylib_read_cache_size(int cpu)
+{
+  char path[128], unit = 'K';
+  long size, best_size = 0;
+  int index, level, best_level = 0;
+
+  for (index = 0; index < 16; ++index)
+  {
+    FILE *file;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+    level = mylib_read_int(path, -1);
+    if (level < 0)
+      break;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/size", cpu, index);
+    file = fopen(path, "r");
+    if (!file)
+      continue;
+    if (fscanf(file, "%ld%c", &size, &unit) >= 1 && level >= best_level)
+    {
+      best_level = level;
+      best_size  = size * ((unit == 'M') ? 1024 * 1024 : (unit == 'K') ? 1024 : 1);
+    }
+    fclose(file);
+  }
+
+  return best_size;
+}
+
+/* Discovers the topology from /sys/devices/system/cpu and /sys/devices/system/node. */
+static void mylib_topology_discover(void)
+{
+  char path[128];
+  cpu_set_t allowed;
+  mylib_CPU *sorted;
+  int *core_package, *core_id;
+  int cpu, i, j, n, node, max_node = 0;
+
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    CPU_SET(0, &allowed);
+
+  n = CPU_COUNT(&allowed);
+  mylib_topology.cpus    = (mylib_CPU *)malloc(n * sizeof(mylib_CPU));
+  mylib_topology.compact = (int *)malloc(n * sizeof(int));
+  mylib_topology.scatter = (int *)malloc(n * sizeof(int));
+  sorted       = (mylib_CPU *)malloc(n * sizeof(mylib_CPU));
+  core_package = (int *)malloc(n * sizeof(int));
+  core_id      = (int *)malloc(n * sizeof(int));
+  if (!mylib_topology.cpus || !mylib_topology.compact || !mylib_topology.scatter || !sorted || !core_package || !core_id)
+  {
+    free(sorted);
+    free(core_package);
+    free(core_id);
+    mylib_topology.num_cpus = 0;
+    return;
+  }
+
+  mylib_topology.num_cpus  = 0;
+  mylib_topology.num_cores = 0;
+  for (cpu = 0; cpu < CPU_SETSIZE && mylib_topology.num_cpus < n; ++cpu)
+  {
+    mylib_CPU *entry = mylib_topology.cpus + mylib_topology.num_cpus;
+    int package, id;
+
+    if (!CPU_ISSET(cpu, &allowed))
+      continue;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    package = mylib_read_int(path, 0);
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+    id = mylib_read_int(path, cpu);
+
+    /* core_id is only unique within a package, hence map (package, core_id) to a dense core index */
+    for (j = 0; j < mylib_topology.num_cores; ++j)
+      if (core_package[j] == package && core_id[j] == id)
+        break;
+    if (j == mylib_topology.num_cores)
+    {
+      core_package[j] = package;
+      core_id[j]      = id;
+      ++mylib_topology.num_cores;
+    }
+
+    /* nodeN directories only exist on NUMA-enabled kernels, otherwise everything is node 0 */
+    entry->node = 0;
+    for (node = 0; node < 1024; ++node)
+    {
+      snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+      if (mylib_cpulist_contains(path, cpu))
+      {
+        entry->node = node;
+        break;
+      }
+    }
+    if (entry->node > max_node)
+      max_node = entry->node;
+
+    entry->cpu     = cpu;
+    entry->core    = j;
+    entry->package = package;
+    entry->sibling = 0;
+    for (i = 0; i < mylib_topology.num_cpus; ++i)
+      if (mylib_topology.cpus[i].core == j)
+        ++entry->sibling;
+
+    ++mylib_topology.num_cpus;
+  }
+  mylib_topology.num_nodes = max_node + 1;
+
+  /* one last-level cache per package, read from the first cpu of the package */
+  mylib_topology.cache_bytes = 0;
+  for (i = 0; i < mylib_topology.num_cpus; ++i)
+  {
+    for (j = 0; j < i; ++j)
+      if (mylib_topology.cpus[j].package == mylib_topology.cpus[i].package)
+        break;
+    if (j == i)
+      mylib_topology.cache_bytes += mylib_read_cache_size(mylib_topology.cpus[i].cpu);
+  }
+
+  /* compact order */
+  memcpy(sorted, mylib_topology.cpus, mylib_topology.num_cpus * sizeof(mylib_CPU));
+  qsort(sorted, mylib_topology.num_cpus, sizeof(mylib_CPU), mylib_compare_compact);
+  for (i = 0; i < mylib_topology.num_cpus; ++i)
+    for (j = 0; j < mylib_topology.num_cpus; ++j)
+      if (mylib_topology.cpus[j].cpu == sorted[i].cpu)
+        mylib_topology.compact[i] = j;
+
+  /* scatter order: sort by (sibling, node, package, core), then take the entries of the nodes in turns */
+  memcpy(sorted, mylib_topology.cpus, mylib_topology.num_cpus * sizeof(mylib_CPU));
+  qsort(sorted, mylib_topology.num_cpus, sizeof(mylib_CPU), mylib_compare_scatter);
+  for (i = 0, node = 0; i < mylib_topology.num_cpus; node = (node + 1) % mylib_topology.num_nodes)
+  {
+    for (j = 0; j < mylib_topology.num_cpus; ++j)
+    {
+      if (sorted[j].cpu >= 0 && sorted[j].node == node)
+      {
+        int k;
+        for (k = 0; k < mylib_topology.num_cpus; ++k)
+          if (mylib_topology.cpus[k].cpu == sorted[j].cpu)
+            mylib_topology.scatter[i++] = k;
+        sorted[j].cpu = -1;   /* taken */
+        break;
+      }
+    }
+  }
+
+  free(sorted);
+  free(core_package);
+  free(core_id);
+}
+
+
+/* Reports the number of hardware threads the process may run on, and the number of cores and NUMA nodes they belong to. */
+int mylib_get_topology(int *num_cpus, int *num_cores, int *num_nodes)
+{
+  pthread_once(&mylib_topology_once, mylib_topology_discover);
+
+  if (mylib_topology.num_cpus == 0)
+    return MYLIB_ERROR_OUT_OF_MEMORY;
+
+  if (num_cpus)
+    *num_cpus = mylib_topology.num_cpus;
+  if (num_cores)
+    *num_cores = mylib_topology.num_cores;
+  if (num_nodes)
+    *num_nodes = mylib_topology.num_nodes;
+  return MYLIB_SUCCESS;
+}
+
+/* Returns the NUMA node of the given OS cpu number, 0 if unknown. */
+int mylib_topology_node_of_cpu(int cpu)
+{
+  int i;
+
+  pthread_once(&mylib_topology_once, mylib_topology_discover);
+
+  for (i = 0; i < mylib_topology.num_cpus; ++i)
+    if (mylib_topology.cpus[i].cpu == cpu)
+      return mylib_topology.cpus[i].node;
+  return 0;
+}
+
+/* Returns the aggregate size in bytes of the last-level caches available to the process, 0 if unknown. */
+long mylib_topology_cache_bytes(void)
+{
+  pthread_once(&mylib_topology_once, mylib_topology_discover);
+
+  return mylib_topology.cache_bytes;
+}
+
+
+/************** Thread placement ****************/
+
+/* Pins the calling thread according to its tid and the placement policy, and records core and node in tcontrol. */
+int mylib_ThreadControl_pin(mylib_ThreadControl tcontrol, int placement)
+{
+  cpu_set_t cpuset;
+  mylib_CPU *cpu;
+  int err = mylib_get_topology(NULL, NULL, NULL);
+
+  if (err)
+    return err;
+
+  if (placement == MYLIB_PLACEMENT_NONE)
+  {
+    /* Only record where the thread currently runs. Without pinning this may change at any time. */
+    int current = sched_getcpu();
+    int i;
+
+    tcontrol->core = -1;
+    tcontrol->node = -1;
+    for (i = 0; i < mylib_topology.num_cpus; ++i)
+    {
+      if (mylib_topology.cpus[i].cpu == current)
+      {
+        tcontrol->core = mylib_topology.cpus[i].core;
+        tcontrol->node = mylib_topology.cpus[i].node;
+      }
+    }
+    return MYLIB_SUCCESS;
+  }
+
+  if (placement == MYLIB_PLACEMENT_COMPACT)
+    cpu = mylib_topology.cpus + mylib_topology.compact[tcontrol->tid % mylib_topology.num_cpus];
+  else if (placement == MYLIB_PLACEMENT_SCATTER)
+    cpu = mylib_topology.cpus + mylib_topology.scatter[tcontrol->tid % mylib_topology.num_cpus];
+  else
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu->cpu, &cpuset);
+  if (sched_setaffinity(0, sizeof(cpuset), &cpuset) != 0)
+  {
+    /* The thread runs wherever it did before, so a previous placement no longer holds */
+    tcontrol->core = -1;
+    tcontrol->node = -1;
+    return MYLIB_ERROR_NOT_SUPPORTED;
+  }
+
+  tcontrol->core = cpu->core;
+  tcontrol->node = cpu->node;
+  return MYLIB_SUCCESS;
+}
+
+/* Data of mylib_pin_job() */
+typedef struct
+{
+  int placement;
+  int err;          /* largest error code of all threads, set by thread 0 */
+} mylib_PinJob;
+
+/* mylib_run() job pinning each thread of a pool. The error codes of the threads are combined, so that a failure on any worker is reported. */
+static void mylib_pin_job(mylib_ThreadControl tcontrol, void *data)
+{
+  mylib_PinJob *job = (mylib_PinJob *)data;
+  double err = mylib_ThreadControl_pin(tcontrol, job->placement);
+
+  mylib_ThreadControl_allreduce_double(tcontrol, err, MYLIB_OP_MAX, &err);
+  if (tcontrol->tid == 0)
+    job->err = (int)err;
+}
+
+/* Pins all threads of a pool-backed ThreadFactory, including the calling thread as thread 0. */
+int mylib_ThreadFactory_pin_pool(mylib_ThreadFactory tfactory, int placement)
+{
+  mylib_PinJob job = {placement, MYLIB_SUCCESS};
+  int err = mylib_get_topology(NULL, NULL, NULL);
+
+  if (err)
+    return err;
+  if (placement != MYLIB_PLACEMENT_NONE && placement != MYLIB_PLACEMENT_COMPACT && placement != MYLIB_PLACEMENT_SCATTER)
+    return MYLIB_ERROR_INVALID_ARGUMENT;
+
+  err = mylib_run(tfactory, mylib_pin_job, &job);
+  return err ? err : job.err;
+}
@@ -0,0 +1,548 @@
+/**
+* Correctness test for the kernel tables of mylib.
+*
+* Compares the kernels of every instruction set supported by the CPU (see mylib_kernels_select()) to the scalar kernels,
+* for all lengths up to MAX_LENGTH and offsets of 0 to MAX_OFFSET elements from a cache-line-aligned address, i.e. aligned and unaligned data and all tails.
+* Element-wise kernels must match exactly, kernels with fused multiply-adds or reductions up to rounding.
+* Outputs are surrounded by guard bands, which must not be written.
+*
+* Usage: ./test_kernels
+*
+* License: MIT/X11 license (see file LICENSE.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "mylib_internal.h"
+
+/* Largest vector length tested */
+#define MAX_LENGTH  300
+
+/* Largest offset from an aligned address in elements */
+#define MAX_OFFSET  8
+
+/* Elements after the end of each output which must stay untouched */
+#define GUARD  16
+
+/* Value of the guard bands */
+#define SENTINEL  -12345.5
+
+/* Number of vectors for mdot and maxpy */
+#define MAX_VECTORS  9
+
+/* Largest panel length and tile size of the matrix-matrix kernel */
+#define MAX_KC    40
+#define MAX_TILE  16
+
+/* Buffer size: offset, vector, guard band */
+#define BUFFER_SIZE  (MAX_OFFSET + MAX_LENGTH + GUARD)
+
+static int num_errors = 0;
+
+/* Reports a failure. Only the first failures are printed. */
+static void fail(const char *isa, const char *kernel, int n, int offset, const char *what)
+{
+  if (++num_errors <= 20)
+    printf("Error: %s %s, length %d, offset %d: %s\n", isa, kernel, n, offset, what);
+}
+
+/* Fills buffer with reproducible values of varying sign and magnitude */
+static void fill(double *buffer, int count, int seed)
+{
+  int i;
+
+  for (i = 0; i < count; ++i)
+    buffer[i] = ((i * 7919 + seed * 104729) % 2001 - 1000) / 250.0;
+}
+
+static void fill_float(float *buffer, int count, int seed)
+{
+  int i;
+
+  for (i = 0; i < count; ++i)
+    buffer[i] = (float)(((i * 7919 + seed * 104729) % 2001 - 1000) / 250.0);
+}
+
+/* Sets all elements of buffer to SENTINEL */
+static void clear(double *buffer)
+{
+  int i;
+
+  for (i = 0; i < BUFFER_SIZE; ++i)
+    buffer[i] = SENTINEL;
+}
+
+static void clear_float(float *buffer)
+{
+  int i;
+
+  for (i = 0; i < BUFFER_SIZE; ++i)
+    buffer[i] = (float)SENTINEL;
+}
+
+/* Returns nonzero if the elements before offset and after offset + n are untouched */
+static int guard_intact(const double *buffer, int offset, int n)
+{
+  int i;
+
+  for (i = 0; i < offset; ++i)
+    if (buffer[i] != SENTINEL)
+      return 0;
+  for (i = offset + n; i < BUFFER_SIZE; ++i)
+    if (buffer[i] != SENTINEL)
+      return 0;
+  return 1;
+}
+
+static int guard_intact_float(const float *buffer, int offset, int n)
+{
+  int i;
+
+  for (i = 0; i < offset; ++i)
+    if (buffer[i] != (float)SENTINEL)
+      return 0;
+  for (i = offset + n; i < BUFFER_SIZE; ++i)
+    if (buffer[i] != (float)SENTINEL)
+      return 0;
+  return 1;
+}
+
+/* Returns nonzero if got equals want up to eps times scale, the sum of the magnitudes of the terms */
+static int close_to(double got, double want, double scale, double eps)
+{
+  return fabs(got - want) <= eps * (scale + DBL_MIN);
+}
+
+/* Returns the sum of |x[i] * y[i]| for i < n */
+static double magnitude(const double *x, const double *y, int n)
+{
+  double result = 0;
+  int i;
+
+  for (i = 0; i < n; ++i)
+    result += fabs(x[i] * (y ? y[i] : 1.0));
+  return result;
+}
+
+/* Buffers of the tests, aligned to a cache line */
+static double *in1, *in2, *in3, *out, *ref, *out2;
+static double *vectors[MAX_VECTORS];
+static float *fin1, *fin2, *fout;
+
+/* Packed panels of the matrix-matrix kernel */
+static double *panel_a, *panel_b;
+
+/* Element-wise and reduction kernels on double vectors */
+static void test_vector_kernels(const mylib_Kernels *k, const mylib_Kernels *s, int n, int off)
+{
+  const char *isa = k->name;
+  double *x = in1 + off, *y = in2 + (off + 3) % (MAX_OFFSET + 1), *z = in3 + (off + 5) % (MAX_OFFSET + 1);
+  double scale, alpha = -1.75, want;
+  int i;
+
+  /* add and add_stream */
+  clear(out);
+  k->add(x, y, out + off, n);
+  for (i = 0; i < n; ++i)
+    if (out[off + i] != x[i] + y[i])
+    {
+      fail(isa, "add", n, off, "wrong result");
+      break;
+    }
+  if (!guard_intact(out, off, n))
+    fail(isa, "add", n, off, "guard band overwritten");
+
+  clear(out);
+  k->add_stream(x, y, out + off, n);
+  for (i = 0; i < n; ++i)
+    if (out[off + i] != x[i] + y[i])
+    {
+      fail(isa, "add_stream", n, off, "wrong result");
+      break;
+    }
+  if (!guard_intact(out, off, n))
+    fail(isa, "add_stream", n, off, "guard band overwritten");
+
+  /* dot and asum */
+  scale = magnitude(x, y, n);
+  if (!close_to(k->dot(x, y, n), s->dot(x, y, n), scale, 1e-14))
+    fail(isa, "dot", n, off, "wrong result");
+  if (!close_to(k->asum(x, n), s->asum(x, n), magnitude(x, NULL, n), 1e-14))
+    fail(isa, "asum", n, off, "wrong result");
+  if (k->amax(x, n) != s->amax(x, n))
+    fail(isa, "amax", n, off, "wrong result");
+
+  /* axpy, compared up to the rounding of a fused multiply-add */
+  clear(out);
+  clear(ref);
+  memcpy(out + off, y, n * sizeof(double));
+  memcpy(ref + off, y, n * sizeof(double));
+  k->axpy(alpha, x, out + off, n);
+  s->axpy(alpha, x, ref + off, n);
+  for (i = 0; i < n; ++i)
+    if (!close_to(out[off + i], ref[off + i], fabs(alpha * x[i]) + fabs(y[i]), 4 * DBL_EPSILON))
+    {
+      fail(isa, "axpy", n, off, "wrong result");
+      break;
+    }
+  if (!guard_intact(out, off, n))
+    fail(isa, "axpy", n, off, "guard band overwritten");
+
+  /* scal */
+  clear(out);
+  memcpy(out + off, x, n * sizeof(double));
+  k->scal(alpha, out + off, n);
+  for (i = 0; i < n; ++i)
+    if (out[off + i] != alpha * x[i])
+    {
+      fail(isa, "scal", n, off, "wrong result");
+      break;
+    }
+  if (!guard_intact(out, off, n))
+    fail(isa, "scal", n, off, "guard band overwritten");
+
+  /* swap */
+  clear(out);
+  clear(out2);
+  memcpy(out + off, x, n * sizeof(double));
+  memcpy(out2 + (off + 3) % (MAX_OFFSET + 1), y, n * sizeof(double));
+  k->swap(out + off, out2 + (off + 3) % (MAX_OFFSET + 1), n);
+  if (memcmp(out + off, y, n * sizeof(double)) || memcmp(out2 + (off + 3) % (MAX_OFFSET + 1), x, n * sizeof(double)))
+    fail(isa, "swap", n, off, "wrong result");
+  if (!guard_intact(out, off, n) || !guard_intact(out2, (off + 3) % (MAX_OFFSET + 1), n))
+    fail(isa, "swap", n, off, "guard band overwritten");
+
+  /* axpy_dot, with a separate z and with z = y */
+  clear(out);
+  clear(ref);
+  memcpy(out + off, y, n * sizeof(double));
+  memcpy(ref + off, y, n * sizeof(double));
+  scale = magnitude(y, z, n) + 2 * fabs(alpha) * magnitude(x, z, n);
+  if (!close_to(k->axpy_dot(alpha, x, out + off, z, n), s->axpy_dot(alpha, x, ref + off, z, n), scale, 1e-14))
+    fail(isa, "axpy_dot", n, off, "wrong dot product");
+  for (i = 0; i < n; ++i)
+    if (!close_to(out[off + i], ref[off + i], fabs(alpha * x[i]) + fabs(y[i]), 4 * DBL_EPSILON))
+    {
+      fail(isa, "axpy_dot", n, off, "wrong update");
+      break;
+    }
+  if (!guard_intact(out, off, n))
+    fail(isa, "axpy_dot", n, off, "guard band overwritten");
+
+  memcpy(out + off, y, n * sizeof(double));
+  memcpy(ref + off, y, n * sizeof(double));
+  want  = s->axpy_dot(alpha, x, ref + off, ref + off, n);
+  scale = 2 * magnitude(ref + off, ref + off, n) + 1;
+  if (!close_to(k->axpy_dot(alpha, x, out + off, out + off, n), want, scale, 1e-14))
+    fail(isa, "axpy_dot", n, off, "wrong squared norm");
+
+  /* add_dot, with a separate v3 and with v3 = vresult */
+  clear(out);
+  scale = magnitude(x, z, n) + magnitude(y, z, n);
+  if (!close_to(k->add_dot(x, y, out + off, z, n), s->add_dot(x, y, ref + off, z, n), scale, 1e-14))
+    fail(isa, "add_dot", n, off, "wrong dot product");
+  for (i = 0; i < n; ++i)
+    if (out[off + i] != x[i] + y[i])
+    {
+      fail(isa, "add_dot", n, off, "wrong sum");
+      break;
+    }
+  if (!guard_intact(out, off, n))
+    fail(isa, "add_dot", n, off, "guard band overwritten");
+
+  want  = s->add_dot(x, y, ref + off, ref + off, n);
+  scale = magnitude(ref + off, ref + off, n);
+  if (!close_to(k->add_dot(x, y, out + off, out + off, n), want, scale, 1e-14))
+    fail(isa, "add_dot", n, off, "wrong squared norm");
+}
+
+/* mdot and maxpy for 1 to MAX_VECTORS vectors. The vectors are accessed at 'off' from their start, as in blocked loops. */
+static void test_multi_kernels(const mylib_Kernels *k, const mylib_Kernels *s, int n, int off)
+{
+  const char *isa = k->name;
+  const double *y[MAX_VECTORS];
+  double alpha[MAX_VECTORS], results[MAX_VECTORS + 1], want[MAX_VECTORS + 1];
+  double *x = in1 + (off + 2) % (MAX_OFFSET + 1);
+  int num, j, i;
+
+  for (j = 0; j < MAX_VECTORS; ++j)
+  {
+    y[j]     = vectors[j];
+    alpha[j] = 0.5 - 0.25 * j;
+  }
+
+  for (num = 1; num <= MAX_VECTORS; ++num)
+  {
+    for (j = 0; j <= num; ++j)
+      results[j] = want[j] = j;
+    k->mdot(x, y, num, off, n, results);
+    s->mdot(x, y, num, off, n, want);
+    for (j = 0; j < num; ++j)
+      if (!close_to(results[j], want[j], magnitude(x, y[j] + off, n) + j, 1e-14))
+      {
+        fail(isa, "mdot", n, off, "wrong result");
+        break;
+      }
+    if (results[num] != num)
+      fail(isa, "mdot", n, off, "result beyond k overwritten");
+
+    clear(out);
+    clear(ref);
+    memcpy(out + off, x, n * sizeof(double));
+    memcpy(ref + off, x, n * sizeof(double));
+    k->maxpy(alpha, y, num, off, n, out + off);
+    s->maxpy(alpha, y, num, off, n, ref + off);
+    for (i = 0; i < n; ++i)
+    {
+      double scale = fabs(x[i]);
+
+      for (j = 0; j < num; ++j)
+        scale += fabs(alpha[j] * y[j][off + i]);
+      if (!close_to(out[off + i], ref[off + i], scale, 1e-14))
+      {
+        fail(isa, "maxpy", n, off, "wrong result");
+        break;
+      }
+    }
+    if (!guard_intact(out, off, n))
+      fail(isa, "maxpy", n, off, "guard band overwritten");
+  }
+}
+
+/* Single precision kernels */
+static void test_float_kernels(const mylib_Kernels *k, const mylib_Kernels *s, int n, int off)
+{
+  const char *isa = k->name;
+  float *x = fin1 + off, *y = fin2 + (off + 3) % (MAX_OFFSET + 1);
+  double scale = 0;
+  int i;
+
+  clear_float(fout);
+  k->add_float(x, y, fout + off, n);
+  for (i = 0; i < n; ++i)
+    if (fout[off + i] != x[i] + y[i])
+    {
+      fail(isa, "add_float", n, off, "wrong result");
+      break;
+    }
+  if (!guard_intact_float(fout, off, n))
+    fail(isa, "add_float", n, off, "guard band overwritten");
+
+  clear_float(fout);
+  k->add_stream_float(x, y, fout + off, n);
+  for (i = 0; i < n; ++i)
+    if (fout[off + i] != x[i] + y[i])
+    {
+      fail(isa, "add_stream_float", n, off, "wrong result");
+      break;
+    }
+  if (!guard_intact_float(fout, off, n))
+    fail(isa, "add_stream_float", n, off, "guard band overwritten");
+
+  for (i = 0; i < n; ++i)
+    scale += fabs((double)x[i] * y[i]);
+  if (!close_to(k->dot_float(x, y, n), s->dot_float(x, y, n), scale, 1e-5))
+    fail(isa, "dot_float", n, off, "wrong result");
+  if (!close_to(k->dsdot(x, y, n), s->dsdot(x, y, n), scale, 1e-14))
+    fail(isa, "dsdot", n, off, "wrong result");
+}
+
+/* Matrix-matrix kernel on packed panels of length kc, compared to a direct computation. c has a leading dimension beyond the tile, which must not be written. */
+static void test_gemm_kernel(const mylib_Kernels *k, int kc, int off)
+{
+  int mr = k->gemm_mr, nr = k->gemm_nr, ldc = nr + 3;
+  int i, j, p;
+
+  if (mr > MAX_TILE || nr > MAX_TILE || mr * ldc + off > BUFFER_SIZE)
+  {
+    fail(k->name, "gemm", kc, off, "tile too large for the test");
+    return;
+  }
+
+  fill(panel_a, mr * kc, 11);
+  fill(panel_b, nr * kc, 12);
+  clear(out);
+  for (i = 0; i < mr; ++i)
+    for (j = 0; j < nr; ++j)
+      out[off + i * ldc + j] = i - j;
+
+  k->gemm(kc, panel_a, panel_b, out + off, ldc);
+
+  for (i = 0; i < mr; ++i)
+  {
+    for (j = 0; j < nr; ++j)
+    {
+      double want = i - j, scale = fabs(want);
+
+      for (p = 0; p < kc; ++p)
+      {
+        want  += panel_a[p * mr + i] * panel_b[p * nr + j];
+        scale += fabs(panel_a[p * mr + i] * panel_b[p * nr + j]);
+      }
+      if (!close_to(out[off + i * ldc + j], want, scale, 1e-14))
+        fail(k->name, "gemm", kc, off, "wrong result");
+    }
+    for (j = nr; j < ldc; ++j)
+      if (out[off + i * ldc + j] != SENTINEL)
+        fail(k->name, "gemm", kc, off, "entry beyond the tile overwritten");
+  }
+}
+
+/* SELL-C-sigma chunk kernel for chunk heights 1 to 20 */
+static void test_sell_kernel(const mylib_Kernels *k, const mylib_Kernels *s, int width)
+{
+  int cols[MAX_LENGTH];
+  int c, i;
+
+  for (c = 1; c <= 20; ++c)
+  {
+    if (c * width > MAX_LENGTH)
+      break;
+
+    fill(in1, c * width, c);
+    for (i = 0; i < c * width; ++i)
+      cols[i] = (i * 37 + c) % MAX_LENGTH;
+
+    clear(out);
+    clear(ref);
+    k->sell(c, width, in1, cols, in2, out);
+    s->sell(c, width, in1, cols, in2, ref);
+    for (i = 0; i < c; ++i)
+      if (!close_to(out[i], ref[i], 1000.0 * width, 1e-14))
+      {
+        fail(k->name, "sell", width, c, "wrong result");
+        break;
+      }
+    if (!guard_intact(out, 0, c))
+      fail(k->name, "sell", width, c, "guard band overwritten");
+  }
+}
+
+/* SELL-C-sigma chunk kernel with padding: the entries of x referenced only by padding are Inf and NaN, which must not reach the results */
+static void test_sell_padding(const mylib_Kernels *k, int width)
+{
+  double x[8] = {INFINITY, NAN, -INFINITY, 1.5, -2.0, 0.25, 3.0, -0.5};
+  int cols[MAX_LENGTH];
+  int c, r, j;
+
+  for (c = 1; c <= 20; ++c)
+  {
+    if (c * width > MAX_LENGTH)
+      break;
+
+    /* Row r has r % (width + 1) entries, in columns 3 to 7 of x, the rest is padding */
+    fill(in1, c * width, c);
+    for (j = 0; j < width; ++j)
+      for (r = 0; r < c; ++r)
+        if (j < r % (width + 1))
+          cols[j * c + r] = 3 + (j + r) % 5;
+        else
+        {
+          cols[j * c + r] = -1;
+          in1[j * c + r]  = 0;
+        }
+
+    for (r = 0; r < c; ++r)
+    {
+      ref[r] = 0;
+      for (j = 0; j < r % (width + 1); ++j)
+        ref[r] += in1[j * c + r] * x[cols[j * c + r]];
+    }
+
+    clear(out);
+    k->sell(c, width, in1, cols, x, out);
+    for (r = 0; r < c; ++r)
+      if (!close_to(out[r], ref[r], 1000.0 * width, 1e-14))
+      {
+        fail(k->name, "sell padding", width, c, isfinite(out[r]) ? "wrong result" : "non-finite x in padding reached the result");
+        break;
+      }
+    if (!guard_intact(out, 0, c))
+      fail(k->name, "sell padding", width, c, "guard band overwritten");
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  const mylib_Kernels *scalar = mylib_kernels_select(MYLIB_ISA_SCALAR);
+  int isa, n, off, j;
+
+  in1  = (double *)mylib_aligned_malloc(BUFFER_SIZE * sizeof(double));
+  in2  = (double *)mylib_aligned_malloc(BUFFER_SIZE * sizeof(double));
+  in3  = (double *)mylib_aligned_malloc(BUFFER_SIZE * sizeof(double));
+  out  = (double *)mylib_aligned_malloc(BUFFER_SIZE * sizeof(double));
+  ref  = (double *)mylib_aligned_malloc(BUFFER_SIZE * sizeof(double));
+  out2 = (double *)mylib_aligned_malloc(BUFFER_SIZE * sizeof(double));
+  fin1 = (float *)mylib_aligned_malloc(BUFFER_SIZE * sizeof(float));
+  fin2 = (float *)mylib_aligned_malloc(BUFFER_SIZE * sizeof(float));
+  fout = (float *)mylib_aligned_malloc(BUFFER_SIZE * sizeof(float));
+  panel_a = (double *)mylib_aligned_malloc(MAX_KC * MAX_TILE * sizeof(double));
+  panel_b = (double *)mylib_aligned_malloc(MAX_KC * MAX_TILE * sizeof(double));
+  for (j = 0; j < MAX_VECTORS; ++j)
+    vectors[j] = (double *)mylib_aligned_malloc(BUFFER_SIZE * sizeof(double));
+
+  for (isa = MYLIB_ISA_SCALAR; isa <= MYLIB_ISA_AVX512; ++isa)
+  {
+    const mylib_Kernels *kernels = mylib_kernels_select(isa);
+    int errors_before = num_errors;
+
+    if (!kernels)
+      continue;
+
+    for (off = 0; off <= MAX_OFFSET; ++off)
+    {
+      fill(in1, BUFFER_SIZE, 1);
+      fill(in2, BUFFER_SIZE, 2);
+      fill(in3, BUFFER_SIZE, 3);
+      fill_float(fin1, BUFFER_SIZE, 4);
+      fill_float(fin2, BUFFER_SIZE, 5);
+      for (j = 0; j < MAX_VECTORS; ++j)
+        fill(vectors[j], BUFFER_SIZE, 6 + j);
+
+      for (n = 0; n <= MAX_LENGTH; ++n)
+      {
+        test_vector_kernels(kernels, scalar, n, off);
+        test_multi_kernels(kernels, scalar, n, off);
+        test_float_kernels(kernels, scalar, n, off);
+      }
+
+      for (n = 0; n <= MAX_KC; ++n)
+        test_gemm_kernel(kernels, n, off);
+    }
+
+    fill(in2, BUFFER_SIZE, 2);
+    for (n = 0; n <= 12; ++n)
+    {
+      test_sell_kernel(kernels, scalar, n);
+      test_sell_padding(kernels, n);
+    }
+
+    printf("%-8s %s\n", kernels->name, (num_errors == errors_before) ? "passed" : "FAILED");
+  }
+
+  for (j = 0; j < MAX_VECTORS; ++j)
+    free(vectors[j]);
+  free(in1);
+  free(in2);
+  free(in3);
+  free(out);
+  free(ref);
+  free(out2);
+  free(fin1);
+  free(fin2);
+  free(fout);
+  free(panel_a);
+  free(panel_b);
+
+  if (num_errors)
+  {
+    printf("%d errors\n", num_errors);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -13,49 +13,11 @@
 */
 
 #include <thread>
-#include <condition_variable>
 #include <vector>
 #include <iostream>
 
 #include "mylib.h"
-
-
-/* Implementation of a C++11 barrier. wait() can be called multiple times.
- * See e.g. http://stackoverflow.com/questions/24465533/implementing-boostbarrier-in-c11 for alternatives.
- *
- * This class will most likely be hidden inside 'mylib' if 'mylib' were a mature library and not just for demonstration purposes.
- */
-class Barrier
-{
-public:
-  explicit Barrier(int num_threads) : threads_required_(num_threads), threads_left_(num_threads), counter_(0) {}
-
-  void wait()
-  {
-    int ctr = counter_;
-    std::unique_lock<std::mutex> lock(mutex_);
-
-    threads_left_ -= 1;
-    if (threads_left_ == 0) // all threads arrived
-    {
-     ++counter_;
-     threads_left_ = threads_required_;
-     condition_.notify_all();
-    }
-    else
-    {
-      condition_.wait(lock, [this, ctr] { return ctr != counter_; });
-    }
-  }
-
-private:
-  int threads_required_;
-  int threads_left_;
-  int counter_;
-  std::mutex              mutex_;
-  std::condition_variable condition_;
-};
-
+#include "cpp11_barrier.hpp"
 
 
 /* Callback routine for synchronization of C++11 threads. */
@@ -80,11 +42,32 @@ typedef struct
   int N;
 } ArgumentT;
 
+/* std::thread entry point for creating the vectors. Each thread initializes the entries it works on, so that they are placed on its NUMA node. */
+void *threaded_init(void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  int begin_index, end_index;
+
+  mylib_vector_alloc(args->tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &args->v1);
+  mylib_vector_alloc(args->tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &args->v2);
+  mylib_vector_alloc(args->tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &args->v3);
+
+  /* Set entries in v1 and v2 */
+  mylib_vector_partition(args->tcontrol, args->N, &begin_index, &end_index);
+  for (int i = begin_index; i < end_index; ++i)
+  {
+    args->v1[i] = i;
+    args->v2[i] = args->N - i;
+  }
+  return NULL;
+}
+
 /* std::thread entry point for vector addition */
 void *threaded_add(void *data)
 {
   ArgumentT *args = (ArgumentT *)data;
   mylib_vector_add(args->tcontrol, args->v1, args->v2, args->v3, args->N);
+  return NULL;
 }
 
 /* std::thread entry point for dot product */
@@ -92,6 +75,7 @@ void *threaded_dot(void *data)
 {
   ArgumentT *args = (ArgumentT *)data;
   mylib_vector_dot(args->tcontrol, args->v1, args->v2, args->v3, args->N);
+  return NULL;
 }
 
 /** Main program. Here is the actual usage of mylib shown. */
@@ -112,42 +96,50 @@ int main(int argc, char **argv)
   tfactory->sync = cpp11thread_sync;
   tfactory->sync_data = (void*)&thread_barrier;
 
-  /* Create vectors with data. Using malloc() for the sake of uniformity with the other two examples. */
-  std::vector<double> v1(N);
-  std::vector<double> v2(N);
-  std::vector<double> v3(N);
+  /*
+   *  Create vectors with data.
+   *  Using mylib_vector_alloc() instead of std::vector, so that allocation and initialization run on the same threads and with the same partition as the subsequent operations.
+   */
+  for (int i=0; i<num_threads; ++i)
+  {
+    mylib_ThreadFactory_get_control(tfactory, 0, i, num_threads, tcontrol.data() + i);
 
-  /* Set entries in v1 and v2 */
-  for (int i=0; i<N; ++i)
+    args[i].tcontrol = tcontrol[i];
+    args[i].N  = N;
+    threads[i] = std::thread(threaded_init, (void*)&args[i]);
+  }
+
+  for (int i=0; i<num_threads; ++i)
   {
-    v1[i] = i;
-    v2[i] = N - i;
+    threads[i].join();
   }
 
+  /* All threads obtained the same vectors */
+  double *v1 = args[0].v1;
+  double *v2 = args[0].v2;
+  double *v3 = args[0].v3;
+
   /*
    *  First operation: Add entries.
    *  Generate a per-thread thread control, wrap arguments, and launch thread.
    */
   for (int i=0; i<num_threads; ++i)
   {
-    mylib_ThreadFactory_create_control(tfactory, tcontrol.data() + i);
-    tcontrol[i]->tid   = i;
-    tcontrol[i]->tsize = num_threads;
+    mylib_ThreadFactory_get_control(tfactory, 0, i, num_threads, tcontrol.data() + i);
 
     /* Note: I could not find a way of passing 'mylib_vector_add' and arguments directly to std::thread(), hence this pthread-like workaround */
     args[i].tcontrol = tcontrol[i];
-    args[i].v1 = v1.data();
-    args[i].v2 = v2.data();
-    args[i].v3 = v3.data();
+    args[i].v1 = v1;
+    args[i].v2 = v2;
+    args[i].v3 = v3;
     args[i].N  = N;
     threads[i] = std::thread(threaded_add, (void*)&args[i]);
   }
 
-  /** Wait for threads to complete. Clean up thread control object. */
+  /** Wait for threads to complete. The thread control objects are kept by the factory for the next operation. */
   for (int i=0; i<num_threads; ++i)
   {
     threads[i].join();
-    mylib_ThreadFactory_destroy_control(tfactory, tcontrol[i]);
   }
 
   std::cout << "Result of vector addition: ";
@@ -159,33 +151,33 @@ int main(int argc, char **argv)
 
   /*
    *  Second operation: Compute dot product.
-   *  Same control flow as before: Create thread control object, wrap function arguments, launch thread.
+   *  Same control flow as before: Obtain thread control object, wrap function arguments, launch thread.
    */
   for (int i=0; i<num_threads; ++i)
   {
-    mylib_ThreadFactory_create_control(tfactory, tcontrol.data() + i);
-    tcontrol[i]->tid   = i;
-    tcontrol[i]->tsize = num_threads;
+    mylib_ThreadFactory_get_control(tfactory, 0, i, num_threads, tcontrol.data() + i);
 
     /* Note: I could not find a way of passing 'mylib_vector_add' and arguments directly to std::thread(), hence this pthread-like workaround */
     args[i].tcontrol = tcontrol[i];
-    args[i].v1 = v1.data();
-    args[i].v2 = v2.data();
-    args[i].v3 = v3.data();
+    args[i].v1 = v1;
+    args[i].v2 = v2;
+    args[i].v3 = v3;
     args[i].N  = N;
     threads[i] = std::thread(threaded_dot, (void*)&args[i]);
   }
 
-  /** Wait for threads to complete. Clean up thread control object. */
+  /** Wait for threads to complete. The thread control objects are kept by the factory for the next operation. */
   for (int i=0; i<num_threads; ++i)
   {
     threads[i].join();
-    mylib_ThreadFactory_destroy_control(tfactory, tcontrol[i]);
   }
 
   std::cout << "Result of dot product: " << v3[0] << std::endl;
 
   /* Clean up */
+  mylib_vector_free(v1);
+  mylib_vector_free(v2);
+  mylib_vector_free(v3);
   mylib_ThreadFactory_destroy(tfactory);
 
   return EXIT_SUCCESS;
@@ -25,17 +25,14 @@ void openmp_sync(int tid, int tsize, void *data)
 }
 
 /* Helper routine for inserting OpenMP thread identification into ThreadControl object.
+   The ThreadControl object is kept by the factory and reused by subsequent parallel regions.
    Also works if compiled without OpenMP (i.e. single-threaded execution). */
 void threads_init(mylib_ThreadFactory tfactory, mylib_ThreadControl *tcontrol)
 {
-  mylib_ThreadFactory_create_control(tfactory, tcontrol);
-
 #ifdef _OPENMP
-  (*tcontrol)->tid   = omp_get_thread_num();
-  (*tcontrol)->tsize = omp_get_num_threads();
+  mylib_ThreadFactory_get_control(tfactory, 0, omp_get_thread_num(), omp_get_num_threads(), tcontrol);
 #else
-  (*tcontrol)->tid   = 0;
-  (*tcontrol)->tsize = 1;
+  mylib_ThreadFactory_get_control(tfactory, 0, 0, 1, tcontrol);
 #endif
 }
 
@@ -74,8 +71,6 @@ int main(int argc, char **argv)
     threads_init(tfactory, &tcontrol);
 
     mylib_vector_add(tcontrol, v1, v2, v3, N);
-
-    mylib_ThreadFactory_destroy_control(tfactory, tcontrol);
   }
 
   printf("Result of vector addition: ");
@@ -93,8 +88,6 @@ int main(int argc, char **argv)
     threads_init(tfactory, &tcontrol);
 
     mylib_vector_dot(tcontrol, v1, v2, v3, N);
-
-    mylib_ThreadFactory_destroy_control(tfactory, tcontrol);
   }
 
   printf("Result of dot product: %g\n", v3[0]);
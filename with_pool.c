@@ -0,0 +1,106 @@
+/**
+* Example C code for demonstrating the persistent worker pool of mylib.
+*
+* In contrast to the other three examples, the threads are not managed by the user code,
+* but by a pool-backed ThreadFactory: The worker threads are created once and parked between calls.
+* mylib_run() fans out a single function call to all threads of the pool, with the calling thread acting as thread 0.
+* The function receives the usual thread control object, so the same worker routines can be used as with user-managed threads.
+*
+* License: MIT/X11 license (see file LICENSE.txt)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "mylib.h"
+
+/* Data holder passed to mylib_run() */
+typedef struct
+{
+  double *v1;
+  double *v2;
+  double *v3;
+  int N;
+} ArgumentT;
+
+/* mylib_run() entry point for creating the vectors. Each thread initializes the entries it works on, so that they are placed on its NUMA node. */
+void pooled_init(mylib_ThreadControl tcontrol, void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  double *v1, *v2, *v3;
+  int i, begin_index, end_index;
+
+  mylib_vector_alloc(tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &v1);
+  mylib_vector_alloc(tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &v2);
+  mylib_vector_alloc(tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &v3);
+
+  /* Set entries in v1 and v2 */
+  mylib_vector_partition(tcontrol, args->N, &begin_index, &end_index);
+  for (i = begin_index; i < end_index; ++i)
+  {
+    v1[i] = (double)i;
+    v2[i] = (double)(args->N - i);
+  }
+
+  if (tcontrol->tid == 0)
+  {
+    args->v1 = v1;
+    args->v2 = v2;
+    args->v3 = v3;
+  }
+}
+
+/* mylib_run() entry point for vector addition */
+void pooled_add(mylib_ThreadControl tcontrol, void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  mylib_vector_add(tcontrol, args->v1, args->v2, args->v3, args->N);
+}
+
+/* mylib_run() entry point for dot product */
+void pooled_dot(mylib_ThreadControl tcontrol, void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  mylib_vector_dot(tcontrol, args->v1, args->v2, args->v3, args->N);
+}
+
+
+/** Main program. Here is the actual usage of mylib shown. */
+int main(int argc, char **argv)
+{
+  int i, N = 10, num_threads = 4;
+  mylib_ThreadFactory tfactory;
+  ArgumentT args;
+
+  /* Create thread manager with num_threads-1 persistent workers (the calling thread is the remaining one). */
+  mylib_ThreadFactory_create_pool(&tfactory, num_threads);
+
+  /* Spread the threads over all NUMA nodes and cores for maximum memory bandwidth. */
+  mylib_ThreadFactory_pin_pool(tfactory, MYLIB_PLACEMENT_SCATTER);
+
+  /* Create vectors with data in parallel. */
+  args.N = N;
+  mylib_run(tfactory, pooled_init, &args);
+
+  /* First operation: Add entries. No threads are created, the pooled workers are woken up instead. */
+  mylib_run(tfactory, pooled_add, &args);
+
+  printf("Result of vector addition: ");
+  for (i = 0; i<N; ++i)
+    printf("%g ", args.v3[i]);
+  printf("\n");
+
+  /* Second operation: Compute dot product. */
+  mylib_run(tfactory, pooled_dot, &args);
+
+  printf("Result of dot product: %g\n", args.v3[0]);
+
+  /* Tidy up. Destroying the factory joins the workers. */
+  mylib_vector_free(args.v1);
+  mylib_vector_free(args.v2);
+  mylib_vector_free(args.v3);
+
+  mylib_ThreadFactory_destroy(tfactory);
+
+  return EXIT_SUCCESS;
+}
@@ -39,11 +39,32 @@ typedef struct
   int N;
 } ArgumentT;
 
+/* pthread entry point for creating the vectors. Each thread initializes the entries it works on, so that they are placed on its NUMA node. */
+void *threaded_init(void *data)
+{
+  ArgumentT *args = (ArgumentT *)data;
+  int i, begin_index, end_index;
+
+  mylib_vector_alloc(args->tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &args->v1);
+  mylib_vector_alloc(args->tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &args->v2);
+  mylib_vector_alloc(args->tcontrol, args->N, MYLIB_MEMORY_FIRST_TOUCH, &args->v3);
+
+  /* Set entries in v1 and v2 */
+  mylib_vector_partition(args->tcontrol, args->N, &begin_index, &end_index);
+  for (i = begin_index; i < end_index; ++i)
+  {
+    args->v1[i] = (double)i;
+    args->v2[i] = (double)(args->N - i);
+  }
+  return NULL;
+}
+
 /* pthread entry point */
 void *threaded_add(void *data)
 {
   ArgumentT *args = (ArgumentT *)data;
   mylib_vector_add(args->tcontrol, args->v1, args->v2, args->v3, args->N);
+  return NULL;
 }
 
 /* pthread entry point */
@@ -51,6 +72,7 @@ void *threaded_dot(void *data)
 {
   ArgumentT *args = (ArgumentT *)data;
   mylib_vector_dot(args->tcontrol, args->v1, args->v2, args->v3, args->N);
+  return NULL;
 }
 
 
@@ -79,28 +101,37 @@ int main(int argc, char **argv)
   tcontrol = (mylib_ThreadControl *)malloc(num_threads * sizeof(mylib_ThreadControl));
   args     = (ArgumentT *)          malloc(num_threads * sizeof(ArgumentT));
 
-  /* Create vectors with data. */
-  v1 = malloc(sizeof(double) * N);
-  v2 = malloc(sizeof(double) * N);
-  v3 = malloc(sizeof(double) * N);
+  /*
+   *  Create vectors with data.
+   *  Allocation and initialization run on the same threads and with the same partition as the subsequent operations.
+   */
+  for (i=0; i<num_threads; ++i)
+  {
+    mylib_ThreadFactory_get_control(tfactory, 0, i, num_threads, tcontrol + i);
+
+    args[i].tcontrol = tcontrol[i];
+    args[i].N  = N;
+    pthread_create(threads + i, NULL, threaded_init, (void*)&args[i]);
+  }
 
-  /* Set entries in v1 and v2 */
-  for (i=0; i<N; ++i)
+  for (i=0; i<num_threads; ++i)
   {
-    v1[i] = (double)i;
-    v2[i] = (double)(N - i);
+    pthread_join(threads[i], NULL);
   }
-  
+
+  /* All threads obtained the same vectors */
+  v1 = args[0].v1;
+  v2 = args[0].v2;
+  v3 = args[0].v3;
+
   /*
    *  First operation: Add entries. 
-   *  Set up the thread control object for each thread and then call the entry point threaded_add().
+   *  Obtain the (reused) thread control object for each thread from the factory and then call the entry point threaded_add().
    *  threaded_add is required because pthread only allows to call into functions taking one void pointer as argument.
    */
   for (i=0; i<num_threads; ++i)
   {
-    mylib_ThreadFactory_create_control(tfactory, tcontrol + i);
-    tcontrol[i]->tid   = i;
-    tcontrol[i]->tsize = num_threads;
+    mylib_ThreadFactory_get_control(tfactory, 0, i, num_threads, tcontrol + i);
 
     args[i].tcontrol = tcontrol[i];
     args[i].v1 = v1;
@@ -110,11 +141,10 @@ int main(int argc, char **argv)
     pthread_create(threads + i, NULL, threaded_add, (void*)&args[i]);
   }
 
-  /* Wait for all threads to finish and clean up associated thread control objects */
+  /* Wait for all threads to finish. The thread control objects are kept by the factory for the next operation. */
   for (i=0; i<num_threads; ++i)
   {
     pthread_join(threads[i], NULL);
-    mylib_ThreadFactory_destroy_control(tfactory, tcontrol[i]);
   }
 
   printf("Result of vector addition: ");
@@ -124,13 +154,11 @@ int main(int argc, char **argv)
 
   /*
    *  Second operation: Compute dot product
-   *  Code flow as before: Create thread control object, register thread ID and thread count, pass arguments to entry point 'threaded_dot'.
+   *  Code flow as before: Obtain thread control object for thread ID and thread count, pass arguments to entry point 'threaded_dot'.
    */
   for (i=0; i<num_threads; ++i)
   {
-    mylib_ThreadFactory_create_control(tfactory, tcontrol + i);
-    tcontrol[i]->tid   = i;
-    tcontrol[i]->tsize = num_threads;
+    mylib_ThreadFactory_get_control(tfactory, 0, i, num_threads, tcontrol + i);
 
     args[i].tcontrol = tcontrol[i];
     args[i].v1 = v1;
@@ -140,19 +168,18 @@ int main(int argc, char **argv)
     pthread_create(threads + i, NULL, threaded_dot, (void*)&args[i]);
   }
 
-  /* Wait for all threads to finish and clean up associated thread control objects */
+  /* Wait for all threads to finish. The thread control objects are kept by the factory for the next operation. */
   for (i=0; i<num_threads; ++i)
   {
     pthread_join(threads[i], NULL);
-    mylib_ThreadFactory_destroy_control(tfactory, tcontrol[i]);
   }
 
   printf("Result of dot product: %g\n", v3[0]);
 
   /* Tidy up */
-  free(v1);
-  free(v2);
-  free(v3);
+  mylib_vector_free(v1);
+  mylib_vector_free(v2);
+  mylib_vector_free(v3);
   free(threads);
   free(tcontrol);
   free(args);